@@ -6,17 +6,63 @@
 #define ARGPARSER_ARGPARSER_HPP_
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <iomanip>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
 #include <numeric>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 #include <vector>
 
+// vector instructions used to scan response files, define ARGP_NO_SIMD to
+// use only the scalar code
+#if !defined(ARGP_NO_SIMD) && defined(__AVX2__)
+#    define ARGP_SIMD_AVX2 1
+#    include <immintrin.h>
+#elif !defined(ARGP_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#    define ARGP_SIMD_SSE2 1
+#    include <emmintrin.h>
+#elif !defined(ARGP_NO_SIMD) && (defined(__ARM_NEON) || defined(_M_ARM64))
+#    define ARGP_SIMD_NEON 1
+#    include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+#ifdef ARGP_INSTRUMENT
+#    define ARGP_INSTRUMENT_HOOK(...) __VA_ARGS__
+#else
+#    define ARGP_INSTRUMENT_HOOK(...)
+#endif
+
 namespace argp
 {
 struct split_options;
+struct arg_span;
 class OptionBase;
 class PositionalOptionBase;
 class KeywordOptionBase;
@@ -24,6 +70,27 @@ template <class T>
 class PositionalOption;
 template <class T>
 class KeywordOption;
+template <class T, class Container>
+class MultiKeywordOption;
+template <class T, class Container>
+class PositionalListOption;
+template <class T>
+class LazyPositionalOption;
+template <class T>
+class LazyKeywordOption;
+template <class T, class Fn>
+class CallbackOption;
+class Parser;
+class Subcommand;
+class SubcommandParser;
+class Schema;
+class SchemaResult;
+template <class T, size_t N>
+struct StaticKeywordOption;
+template <class T>
+struct StaticPositionalOption;
+template <class... Opts>
+class StaticParser;
 
 using OptionsList = std::vector<OptionBase *>;
 
@@ -41,6 +108,33 @@ struct split_options
     split_options(const OptionsList &options);
 };
 
+/**
+ * Non-owning view of a contiguous sequence of string views. It is used for
+ * passing command line arguments to options without allocating memory.
+ */
+struct arg_span
+{
+    const std::string_view *strings;
+    size_t count;
+
+    constexpr arg_span();
+    constexpr arg_span(const std::string_view *strings, size_t count);
+    arg_span(const std::vector<std::string_view> &strings);
+
+    constexpr const std::string_view *begin() const;
+    constexpr const std::string_view *end() const;
+    constexpr size_t size() const;
+    constexpr bool empty() const;
+    constexpr const std::string_view &operator[](size_t i) const;
+
+    /**
+     * subspan
+     *
+     * Returns view of `count` strings starting at `offset`.
+     */
+    constexpr arg_span subspan(size_t offset, size_t count) const;
+};
+
 /**
  * This class defines interface that all command line options must use.
  *
@@ -70,6 +164,20 @@ class OptionBase
      */
     virtual void from_string(const std::vector<std::string_view> &strings) = 0;
 
+    /**
+     * from_args
+     *
+     * Same as from_string, but the strings are passed as a non-owning view of
+     * the parsed arguments, so no memory has to be allocated. Parser always
+     * calls this method.
+     *
+     * Default implementation copies the views to a vector and calls
+     * from_string, so subclasses overriding only from_string keep working.
+     * Options of this library override it to avoid the copy, but still call
+     * from_string when it may be overridden by a subclass.
+     */
+    virtual void from_args(arg_span args);
+
  public:
     OptionBase();
     virtual ~OptionBase(){};
@@ -77,10 +185,37 @@ class OptionBase
     /**
      * parse
      *
-     * This method is a public wrapper for from_string method that ensures
-     * the is_set_ field is filled after parsing the parameters.
+     * This method is a public wrapper for from_string and from_args methods
+     * that ensures the is_set_ field is filled after parsing the parameters.
      */
     void parse(const std::vector<std::string_view> &strings);
+    void parse(arg_span args);
+
+    /**
+     * parse_batch
+     *
+     * Parse `count` occurrences of this option, in the given order, as if
+     * parse was called for each of them. Parser calls this method in
+     * PARALLEL_CONVERSION mode and allows the option to use up to `threads`
+     * threads for it.
+     *
+     * If parsing of an occurrence fails, its index is stored to `failed` and
+     * the exception is rethrown. All occurrences before it must be applied.
+     *
+     * Default implementation calls parse for each occurrence sequentially.
+     */
+    virtual void parse_batch(const arg_span *occurrences, size_t count,
+                             size_t threads, size_t &failed);
+
+    /**
+     * converts_in_parallel
+     *
+     * Tells if parse_batch of this option can run concurrently with other
+     * options in PARALLEL_CONVERSION mode. If not, the option is parsed
+     * immediately when it is matched, on the calling thread. Default
+     * implementation returns true.
+     */
+    virtual bool converts_in_parallel() const;
 
     /**
      * get_param_count
@@ -114,6 +249,25 @@ class OptionBase
 
     virtual split_options::Type get_type() const = 0;
 
+    /**
+     * validate
+     *
+     * Options that postpone conversion of their parameters (see
+     * LazyKeywordOption) must convert them in this method and throw
+     * std::invalid_argument exception if it fails. Default implementation
+     * does nothing.
+     */
+    virtual void validate() const;
+
+    /**
+     * reset
+     *
+     * Restore the state before parsing, the option is not set and has its
+     * default value. Subclasses storing values must override this method and
+     * call it. Memory allocated for values is reused when possible.
+     */
+    virtual void reset();
+
     bool is_set() const;
 };
 
@@ -131,10 +285,42 @@ class PositionalOptionBase : public OptionBase
     bool is_required;
 
  public:
+    /**
+     * Guarantees about matches, that let Parser avoid calling it.
+     *
+     * CUSTOM - none
+     * SINGLE - matches exactly when the option is not set yet
+     * LIST - matches every argument, and from_args accepts any number of
+     *   values at once
+     */
+    enum Arity
+    {
+        CUSTOM,
+        SINGLE,
+        LIST
+    };
+
     PositionalOptionBase(std::string name, std::string help, bool is_required);
 
     virtual std::pair<std::string, std::string> get_help() const override;
     virtual split_options::Type get_type() const override;
+
+    /**
+     * get_arity
+     *
+     * Default implementation returns CUSTOM. Options of this library return
+     * CUSTOM too when they are subclassed, so an overridden matches method is
+     * always called.
+     */
+    virtual Arity get_arity() const;
+
+    /**
+     * get_required
+     *
+     * Returns is_required passed to the constructor. Parser reports an error
+     * when the option is not given only with Parser::REQUIRED_POSITIONALS.
+     */
+    bool get_required() const;
 };
 
 /**
@@ -151,37 +337,293 @@ class KeywordOptionBase : public OptionBase
 
     virtual std::pair<std::string, std::string> get_help() const override;
     virtual split_options::Type get_type() const override;
+
+    /**
+     * has_exact_identifiers
+     *
+     * Subclasses should return true if their matches method returns true for
+     * exactly the strings stored in identifiers field and nothing else. Such
+     * options are looked up by Parser in a hash table instead of calling
+     * matches. By default this returns false, so custom matching logic is
+     * always respected. Options of this library return true only when they are
+     * not subclassed, subclasses keeping their matches method can override
+     * this to return true again.
+     */
+    virtual bool has_exact_identifiers() const;
+
+    const std::vector<std::string> &get_identifiers() const;
+
+    /**
+     * has_identifier
+     *
+     * Returns true if `identifier` is one of the strings in identifiers field.
+     */
+    bool has_identifier(std::string_view identifier) const;
+};
+
+/**
+ * Conversion of a command line parameter to a value of type T, used by all
+ * built-in options in place of stream extraction operator. Specialize it for
+ * your types with a static member function
+ *
+ *   static void convert(std::string_view str, T &val);
+ *
+ * which throws std::invalid_argument exception if `str` is not valid. The
+ * library specializes it for std::chrono::duration, byte_size and enums with
+ * enum_names.
+ */
+template <class T, class = void>
+struct converter
+{
+};
+
+/**
+ * Number of bytes, converted from a number with an optional suffix, e.g.
+ * `4GiB`, `512k` or `1.5MB`. Suffixes are case-insensitive, `KiB`, `MiB`, ...
+ * and single letters `K`, `M`, ... are powers of 1024, `kB`, `MB`, ... are
+ * powers of 1000 and `B` is optional. Prefixes go up to `E`, a fraction is
+ * rounded down to whole bytes.
+ */
+struct byte_size
+{
+    uint64_t bytes = 0;
+};
+
+template <>
+struct converter<byte_size>
+{
+    static void convert(std::string_view str, byte_size &val);
+};
+
+/**
+ * Converts a sequence of numbers with units, e.g. `5ms`, `1.5s` or `1h30m`.
+ * Units are `ns`, `us`, `ms`, `s`, `m` or `min`, `h` and `d`, a number
+ * without unit is in the units of the duration. Throws std::invalid_argument
+ * exception if the value does not fit or can't be represented exactly by an
+ * integral representation.
+ */
+template <class Rep, class Period>
+struct converter<std::chrono::duration<Rep, Period>>
+{
+    static void convert(std::string_view str,
+                        std::chrono::duration<Rep, Period> &val);
+};
+
+/**
+ * Names of values of enum E accepted on the command line. Specialize it with
+ * a static constexpr array of name and value pairs named `values`:
+ *
+ *   template <>
+ *   struct argp::enum_names<Color>
+ *   {
+ *       static constexpr std::pair<std::string_view, Color> values[] = {
+ *           {"red", Color::RED}, {"green", Color::GREEN}};
+ *   };
+ *
+ * The names are sorted at compile time and looked up by binary search.
+ */
+template <class E>
+struct enum_names
+{
+};
+
+namespace impl
+{
+
+/**
+ * Tells if enum_names is specialized for type T.
+ */
+template <class T, class = void>
+struct has_enum_names : std::false_type
+{
+};
+
+template <class T>
+struct has_enum_names<T, std::void_t<decltype(enum_names<T>::values)>>
+    : std::true_type
+{
+};
+
+/**
+ * sorted_names
+ *
+ * Returns the name and value pairs sorted by name.
+ */
+template <class E, size_t N>
+constexpr std::array<std::pair<std::string_view, E>, N> sorted_names(
+    const std::pair<std::string_view, E> (&values)[N]);
+
+/**
+ * has_unique_names
+ *
+ * Returns true if no two `sorted` pairs have the same name.
+ */
+template <class E, size_t N>
+constexpr bool has_unique_names(
+    const std::array<std::pair<std::string_view, E>, N> &sorted);
+
+/**
+ * Names of enum E sorted at compile time.
+ */
+template <class E>
+struct enum_table
+{
+    static constexpr auto sorted = sorted_names(enum_names<E>::values);
+};
+
+} // namespace impl
+
+template <class E>
+struct converter<E, std::enable_if_t<std::is_enum_v<E> &&
+                                     impl::has_enum_names<E>::value>>
+{
+    static void convert(std::string_view str, E &val);
+};
+
+namespace impl
+{
+
+/**
+ * is_exact_type
+ *
+ * Returns true if the dynamic type of `option` is T and not a subclass of it.
+ * Options of this library use it to take shortcuts, that would skip methods
+ * overridden by a subclass.
+ */
+template <class T>
+bool is_exact_type(const OptionBase &option);
+
+/**
+ * Tells if values of type T can be copied. Containers are copyable only if
+ * their elements are, as their copy operations are declared either way.
+ */
+template <class T, class = void>
+struct is_copyable
+    : std::bool_constant<std::is_copy_constructible_v<T> &&
+                         std::is_copy_assignable_v<T>>
+{
+};
+
+template <class T>
+struct is_copyable<T, std::void_t<typename T::value_type>>
+    : std::bool_constant<std::is_copy_constructible_v<T> &&
+                         std::is_copy_assignable_v<T> &&
+                         std::is_copy_constructible_v<typename T::value_type>>
+{
+};
+
+/**
+ * Tells if type T has `allocator_type` member type.
+ */
+template <class T, class = void>
+struct has_allocator_type : std::false_type
+{
+};
+
+template <class T>
+struct has_allocator_type<T, std::void_t<typename T::allocator_type>>
+    : std::true_type
+{
+};
+
+/**
+ * copy_with_allocator
+ *
+ * Returns a copy of `val` using the same allocator, as it would otherwise get
+ * the one selected by select_on_container_copy_construction, e.g. the default
+ * memory resource for std::pmr containers.
+ */
+template <class T>
+T copy_with_allocator(const T &val);
+
+/**
+ * Default value of an option, restored by reset. Options keep the object they
+ * were constructed with as their value, and store a copy of it here. Values
+ * of types that can't be copied are not stored, they are reset to
+ * a value-initialized T instead.
+ */
+template <class T, bool = is_copyable<T>::value>
+class default_value
+{
+ private:
+    T val;
+
+ public:
+    default_value(const T &val);
+
+    /**
+     * restore
+     *
+     * Copy the default value into `dst`, reusing its memory and keeping its
+     * allocator.
+     */
+    void restore(T &dst) const;
+};
+
+template <class T>
+class default_value<T, false>
+{
+ public:
+    default_value(const T &val);
+
+    void restore(T &dst) const;
 };
 
+} // namespace impl
+
 /**
  * This class declares a simple positional argument. It tries to parse the first
  * argument that it is given.
  *
  * It converts a single string parameter to the type specified in the template
- * parameter. It uses stream extraction operator to make this conversion, if the
- * type does not support this operator, you must create either it,
- * a specialization of this template or separate class to parse it.
+ * parameter. It uses argp::converter if it is specialized for the type,
+ * otherwise stream extraction operator. If the type supports neither, you
+ * must create one of them, a specialization of this template or separate
+ * class to parse it.
  *
  * There are also specializations for these types:
  * - std::string - convert the whole parameter to the string
+ * - integral and floating point types - converted by std::from_chars, the whole
+ *   parameter must be a number
  */
 template <class T>
 class PositionalOption : public PositionalOptionBase
 {
  protected:
     T val;
+    impl::default_value<T> default_val;
+
+    void assign_args(arg_span args);
 
     virtual void from_string(
         const std::vector<std::string_view> &strings) override;
+    virtual void from_args(arg_span args) override;
 
  public:
     PositionalOption(std::string name, std::string help, bool is_required,
                      T val = T());
 
+    virtual void reset() override;
+
     virtual int get_param_count() override;
     virtual bool matches(std::string_view) override;
+    virtual Arity get_arity() const override;
 
     T get_val() const;
+    /**
+     * value
+     *
+     * Returns reference to the stored value, without copying it.
+     */
+    const T &value() const;
+
+    /**
+     * take
+     *
+     * Move the stored value out of the option.
+     * Usage: `auto val = std::move(option).take();`
+     */
+    T &&take() &&;
 };
 
 /**
@@ -190,105 +632,2220 @@ class PositionalOption : public PositionalOptionBase
  * field.
  *
  * It converts a single string parameter to the type specified in the template
- * parameter. It uses stream extraction operator to make this conversion, if the
- * type does not support this operator, you must create either it,
- * a specialization of this template or separate class to parse it.
+ * parameter. It uses argp::converter if it is specialized for the type,
+ * otherwise stream extraction operator. If the type supports neither, you
+ * must create one of them, a specialization of this template or separate
+ * class to parse it.
  *
  * There are also specializations for these types:
  * - std::string - convert the whole parameter to the string
  * - bool - no additional parameters required, false by default, true if found
+ * - integral and floating point types - converted by std::from_chars, the whole
+ *   parameter must be a number
  */
 template <class T>
 class KeywordOption : public KeywordOptionBase
 {
  protected:
     T val;
+    impl::default_value<T> default_val;
     static const int NUM_OPTS;
 
+    void assign_args(arg_span args);
+
     virtual void from_string(
         const std::vector<std::string_view> &strings) override;
+    virtual void from_args(arg_span args) override;
 
  public:
     KeywordOption(std::vector<std::string> identifiers, std::string help,
                   T val = T());
 
+    virtual void reset() override;
+
     virtual int get_param_count() override;
     virtual bool matches(std::string_view identifier) override;
+    virtual bool has_exact_identifiers() const override;
 
     T get_val() const;
-};
+    /**
+     * value
+     *
+     * Returns reference to the stored value, without copying it.
+     */
+    const T &value() const;
 
-namespace impl
-{
+    /**
+     * take
+     *
+     * Move the stored value out of the option.
+     * Usage: `auto val = std::move(option).take();`
+     */
+    T &&take() &&;
+};
 
 /**
- * match_option
- *
- * Internal function for finding if any option matches the curent argument
- * parsed.
+ * This class declares a keyword argument that can be repeated. Parameter of
+ * every occurrence (`--input a --input b`) is converted the same way as in
+ * KeywordOption and appended to the end of the container.
  *
- * return value:
- * - matching option or nullptr if no option is matched
+ * Container must support `insert(end(), value)`, e.g. std::vector, std::deque,
+ * std::list or std::set. If it has `reserve` method, it can be preallocated
+ * by calling reserve on the option. Values are constructed with allocator of
+ * the container if they support it, so e.g.
+ * `MultiKeywordOption<std::pmr::string, std::pmr::vector<std::pmr::string>>`
+ * allocates only from the memory resource of the container passed to the
+ * constructor.
  */
-OptionBase *match_option(const char *arg, const OptionsList &opts);
+template <class T, class Container = std::vector<T>>
+class MultiKeywordOption : public KeywordOptionBase
+{
+ protected:
+    Container val;
+    impl::default_value<Container> default_val;
+
+    void assign_args(arg_span args);
+
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+    virtual void from_args(arg_span args) override;
+
+ public:
+    MultiKeywordOption(std::vector<std::string> identifiers, std::string help,
+                       Container val = Container());
+
+    virtual void reset() override;
+
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view identifier) override;
+    virtual bool has_exact_identifiers() const override;
+
+    /**
+     * parse_batch
+     *
+     * Converts the occurrences concurrently and appends the values in their
+     * original order.
+     */
+    virtual void parse_batch(const arg_span *occurrences, size_t count,
+                             size_t threads, size_t &failed) override;
+
+    /**
+     * reserve
+     *
+     * Preallocate space for `count` values, if the container supports it.
+     */
+    void reserve(size_t count);
+
+    Container get_val() const;
+
+    /**
+     * value
+     *
+     * Returns reference to the collected values, without copying them.
+     */
+    const Container &value() const;
+
+    /**
+     * take
+     *
+     * Move the collected values out of the option.
+     * Usage: `auto inputs = std::move(option).take();`
+     */
+    Container &&take() &&;
+};
 
 /**
- * handle_match
- *
- * Internal function that calls option's parse method with the right number
- * of arguments when it is found.
+ * This class declares a positional argument, that collects all remaining
+ * positional arguments into a container. Parser passes consecutive arguments,
+ * which are not keywords and do not start with '-', in a single call.
  */
-void handle_match(int &i, OptionBase *opt, int argc, const char *argv[]);
-
-class indented
+template <class T, class Container = std::vector<T>>
+class PositionalListOption : public PositionalOptionBase
 {
- private:
-    std::string_view str;
-    size_t width;
-    char fill;
+ protected:
+    Container val;
+    impl::default_value<Container> default_val;
+
+    void assign_args(arg_span args);
+
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+    virtual void from_args(arg_span args) override;
 
  public:
-    indented(std::string_view str, size_t width, char fill = ' ');
+    PositionalListOption(std::string name, std::string help, bool is_required,
+                         Container val = Container());
 
-    friend std::ostream &operator<<(std::ostream &os, const indented &val);
-};
+    virtual void reset() override;
 
-} // namespace impl
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view) override;
+    virtual Arity get_arity() const override;
 
-/**
- * parse
- *
- * Parse string array according to the options given in the argument.
+    virtual std::pair<std::string, std::string> get_help() const override;
+
+    Container get_val() const;
+
+    /**
+     * value
+     *
+     * Returns reference to the collected values, without copying them.
+     */
+    const Container &value() const;
+
+    /**
+     * take
+     *
+     * Move the collected values out of the option.
+     * Usage: `auto inputs = std::move(option).take();`
+     */
+    Container &&take() &&;
+};
+
+namespace impl
+{
+
+/**
+ * Value converted from a string on the first access. Used by lazy options.
+ *
+ * The raw string is copied, reusing the memory of the previous one, so it
+ * does not depend on the lifetime of the parsed arguments. Conversion is not
+ * synchronised, the value must not be accessed from multiple threads before
+ * it is converted.
+ */
+template <class T>
+class lazy_value
+{
+ private:
+    mutable T val;
+    mutable bool converted;
+    std::string raw;
+
+ public:
+    lazy_value(T val);
+
+    /**
+     * set_raw
+     *
+     * Store string, that will be converted on the next access.
+     */
+    void set_raw(std::string_view raw);
+
+    /**
+     * set
+     *
+     * Store already converted value.
+     */
+    void set(T val);
+
+    /**
+     * reset
+     *
+     * Restore `val` into the stored value, reusing its memory.
+     */
+    void reset(const default_value<T> &val);
+
+    /**
+     * get
+     *
+     * Convert the stored string if it was not converted yet. Throws
+     * std::invalid_argument exception if the conversion fails, the next
+     * access then tries again.
+     */
+    const T &get() const;
+
+    T &&take();
+};
+
+} // namespace impl
+
+/**
+ * This class declares a positional argument, that stores the parameter and
+ * converts it the same way as PositionalOption only when the value is first
+ * accessed, so values that are never read are never converted. Conversion
+ * errors are reported by value and get_val, or by validate.
+ *
+ * The parameter is copied into the option, so it stays valid after the parsed
+ * arguments (including those read from response files) are released.
+ */
+template <class T>
+class LazyPositionalOption : public PositionalOptionBase
+{
+ protected:
+    impl::lazy_value<T> val;
+    impl::default_value<T> default_val;
+
+    void assign_args(arg_span args);
+
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+    virtual void from_args(arg_span args) override;
+
+ public:
+    LazyPositionalOption(std::string name, std::string help, bool is_required,
+                         T val = T());
+
+    virtual void reset() override;
+
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view) override;
+    virtual Arity get_arity() const override;
+    virtual void validate() const override;
+
+    T get_val() const;
+    const T &value() const;
+    T &&take() &&;
+};
+
+/**
+ * This class declares a keyword argument, that stores the parameter and
+ * converts it the same way as KeywordOption only when the value is first
+ * accessed. See LazyPositionalOption for details.
+ *
+ * bool options take no parameters, so they are set immediately.
+ */
+template <class T>
+class LazyKeywordOption : public KeywordOptionBase
+{
+ protected:
+    impl::lazy_value<T> val;
+    impl::default_value<T> default_val;
+
+    void assign_args(arg_span args);
+
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+    virtual void from_args(arg_span args) override;
+
+ public:
+    LazyKeywordOption(std::vector<std::string> identifiers, std::string help,
+                      T val = T());
+
+    virtual void reset() override;
+
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view identifier) override;
+    virtual bool has_exact_identifiers() const override;
+    virtual void validate() const override;
+
+    T get_val() const;
+    const T &value() const;
+    T &&take() &&;
+};
+
+/**
+ * This class declares a keyword argument, which does not store its value.
+ * Every occurrence is converted the same way as by KeywordOption and passed
+ * to `fn` right away, as an lvalue of type T that may be moved from. Options
+ * of type bool take no parameters and pass true.
+ *
+ * Callbacks are always called on the parsing thread in the order of
+ * arguments, PARALLEL_CONVERSION does not defer them (see
+ * converts_in_parallel), so they can share state without synchronisation.
+ *
+ * Use argp::callback_option to deduce the type of the callable.
+ */
+template <class T, class Fn>
+class CallbackOption : public KeywordOptionBase
+{
+ protected:
+    Fn fn;
+
+    /// reused between occurrences, so strings keep their capacity
+    T buffer;
+
+    void assign_args(arg_span args);
+
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+    virtual void from_args(arg_span args) override;
+
+ public:
+    CallbackOption(std::vector<std::string> identifiers, std::string help,
+                   Fn fn);
+
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view identifier) override;
+    virtual bool has_exact_identifiers() const override;
+    virtual bool converts_in_parallel() const override;
+};
+
+/**
+ * callback_option
+ *
+ * Create CallbackOption calling `fn` with values of type T.
+ * Usage: `auto files = argp::callback_option<std::string>({"-f"}, "File.",
+ *     [&](std::string &file) { queue.push(std::move(file)); });`
+ */
+template <class T, class Fn>
+CallbackOption<T, std::decay_t<Fn>> callback_option(
+    std::vector<std::string> identifiers, std::string help, Fn &&fn);
+
+namespace impl
+{
+
+/**
+ * Place of one value of a Schema in the flat storage of SchemaResult, with
+ * the operations needed to manage it.
+ */
+class value_slot
+{
+ public:
+    /// offset of the value in the storage
+    size_t offset = 0;
+
+    virtual ~value_slot() = default;
+
+    virtual size_t size() const  = 0;
+    virtual size_t align() const = 0;
+
+    /// construct the default value in `values`
+    virtual void construct(unsigned char *values) const = 0;
+
+    /// assign the default value to the constructed value in `values`
+    virtual void assign_default(unsigned char *values) const = 0;
+
+    virtual void destroy(unsigned char *values) const = 0;
+
+    /**
+     * convert
+     *
+     * Store the parameters in the value in `values`, args are the same as
+     * for OptionBase::from_args. Throws std::invalid_argument exception if
+     * the conversion fails.
+     */
+    virtual void convert(arg_span args, unsigned char *values) const = 0;
+};
+
+/**
+ * Values of a Schema being parsed, see SchemaResult.
+ */
+struct value_storage
+{
+    /// slot of every option, indexed by option id
+    const value_slot *const *slots;
+
+    /// flat storage of the values
+    unsigned char *values;
+};
+
+/**
+ * Set of option indices stored as bits, so constraints on many options are
+ * checked a word at a time.
+ */
+class option_set
+{
+ private:
+    std::vector<uint64_t> words;
+
+ public:
+    option_set(size_t count = 0);
+
+    /**
+     * assign
+     *
+     * Make the set empty, able to hold indices less than `count`.
+     */
+    void assign(size_t count);
+
+    void insert(size_t id);
+    bool contains(size_t id) const;
+    bool empty() const;
+
+    /**
+     * first_missing
+     *
+     * Returns the lowest index in `other`, that is not in this set, or
+     * static_cast<size_t>(-1) if this set includes all of them.
+     */
+    size_t first_missing(const option_set &other) const;
+
+    /**
+     * has_several_common
+     *
+     * Returns true if at least two indices are in both sets.
+     */
+    bool has_several_common(const option_set &other) const;
+};
+
+/**
+ * Identifiers of keyword options in structure-of-arrays layout. Characters of
+ * all identifiers are in one pool and every other property is in its own
+ * array indexed by entry, so a lookup only touches the hash table, the hash
+ * and length of candidate entries and finally the characters of one entry.
+ */
+class identifier_table
+{
+ private:
+    std::string pool;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<uint64_t> hashes;
+    std::vector<size_t> ids;
+    std::vector<int> param_counts;
+
+    /// open addressing table of entry + 1, 0 marks an empty bucket
+    std::vector<uint32_t> buckets;
+
+    void rehash(size_t bucket_count);
+    void place(size_t entry);
+    size_t find(std::string_view identifier, uint64_t h) const;
+
+ public:
+    static constexpr size_t NO_ENTRY = static_cast<size_t>(-1);
+
+    static uint64_t hash(std::string_view identifier);
+
+    /**
+     * insert
+     *
+     * Add `identifier` of option `id`. Returns false and keeps the existing
+     * entry if the identifier is already present.
+     */
+    bool insert(std::string_view identifier, size_t id, int param_count);
+
+    /**
+     * find
+     *
+     * Returns the entry of `identifier`, or NO_ENTRY.
+     */
+    size_t find(std::string_view identifier) const;
+
+    size_t size() const;
+
+    /// valid until the next insert
+    std::string_view identifier(size_t entry) const;
+    size_t id(size_t entry) const;
+    int param_count(size_t entry) const;
+};
+
+/**
+ * run_parallel
+ *
+ * Call `fn(k)` for every k in [0, count) using up to `threads` threads, the
+ * calling thread included. Calls are distributed dynamically, `fn` must not
+ * throw.
+ */
+template <class Fn>
+void run_parallel(size_t count, size_t threads, Fn &&fn);
+
+/**
+ * Tells if type T has `reserve(size_t)` method.
+ */
+template <class T, class = void>
+struct has_reserve : std::false_type
+{
+};
+
+template <class T>
+struct has_reserve<
+    T, std::void_t<decltype(std::declval<T &>().reserve(size_t()))>>
+    : std::true_type
+{
+};
+
+/**
+ * Tells if argp::converter is specialized for type T.
+ */
+template <class T, class = void>
+struct has_converter : std::false_type
+{
+};
+
+template <class T>
+struct has_converter<T, std::void_t<decltype(converter<T>::convert(
+                            std::declval<std::string_view>(),
+                            std::declval<T &>()))>> : std::true_type
+{
+};
+
+/**
+ * Tells if type T is std::basic_string<char> with any traits and allocator.
+ */
+template <class T>
+struct is_char_string : std::false_type
+{
+};
+
+template <class Traits, class Alloc>
+struct is_char_string<std::basic_string<char, Traits, Alloc>> : std::true_type
+{
+};
+
+/**
+ * make_element
+ *
+ * Create default value of T, that will be inserted to `container`. If T uses
+ * the allocator of the container (e.g. std::pmr::string in
+ * std::pmr::vector), it is constructed with it, so it does not have to be
+ * copied when inserted.
+ */
+template <class T, class Container>
+T make_element(const Container &container);
+
+/**
+ * Tells if type T is converted by std::from_chars instead of a stream. These
+ * are all integral types except bool and character types, and floating point
+ * types if the standard library implements them.
+ */
+template <class T>
+struct is_from_chars_convertible
+    : std::bool_constant<
+          (std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+           !std::is_same_v<T, char> && !std::is_same_v<T, signed char> &&
+           !std::is_same_v<T, unsigned char> && !std::is_same_v<T, wchar_t> &&
+           !std::is_same_v<T, char16_t> && !std::is_same_v<T, char32_t>)
+#if defined(__cpp_lib_to_chars)
+          || std::is_floating_point_v<T>
+#endif
+          >
+{
+};
+
+/**
+ * convert
+ *
+ * Internal function used by all built-in options to convert a single command
+ * line parameter to the value of type T.
+ *
+ * Numbers (see is_from_chars_convertible) are converted by std::from_chars
+ * directly from the view and the whole parameter must be consumed (a single
+ * leading `+` is allowed). Strings (std::basic_string<char> with any
+ * allocator, e.g. std::pmr::string) get the whole parameter and keep their
+ * allocator. All other types use stream extraction operator. A specialization
+ * of argp::converter takes precedence over all of these.
+ *
+ * This function throws std::invalid_argument exception if the conversion
+ * could not be done.
+ */
+template <class T>
+void convert(std::string_view str, T &val);
+
+/**
+ * convert_number
+ *
+ * Internal function implementing convert for types supported by
+ * std::from_chars.
+ */
+template <class T>
+void convert_number(std::string_view str, T &val);
+
+/**
+ * match_option
+ *
+ * Internal function for finding if any option matches the curent argument
+ * parsed.
+ *
+ * return value:
+ * - matching option or nullptr if no option is matched
+ */
+OptionBase *match_option(const char *arg, const OptionsList &opts);
+OptionBase *match_option(const char *arg, const split_options &opts);
+
+/**
+ * handle_match
+ *
+ * Internal function that calls option's parse method with the right number
+ * of arguments when it is found.
+ */
+void handle_match(int &i, OptionBase *opt, int argc, const char *argv[]);
+
+/**
+ * handle_match
+ *
+ * Same as above, but for arguments already converted to string views. `i` is
+ * the index of the matched identifier in `args` and it is moved to the last
+ * argument consumed by the option.
+ */
+void handle_match(size_t &i, OptionBase *opt, arg_span args);
+
+/**
+ * param_span
+ *
+ * Returns the number of parameters following args[i] that the option
+ * requires. Throws the same exceptions as handle_match.
+ */
+size_t param_span(size_t i, OptionBase *opt, arg_span args);
+
+/**
+ * Read-only view of a whole file. Where available, regular files are
+ * memory-mapped privately, so they can be modified in place without changing
+ * the file and only the modified pages are copied. Other files (pipes,
+ * devices, files of an unknown size) are read into a buffer.
+ */
+class mapped_file
+{
+ private:
+    char *addr;
+    size_t length;
+
+    /// contents of the file, if it is not mapped
+    std::unique_ptr<char[]> buffer;
+
+    /**
+     * grow_buffer
+     *
+     * Make room for at least one more byte after `length` in the buffer,
+     * doubling its `capacity`.
+     */
+    void grow_buffer(size_t &capacity);
+
+ public:
+    /**
+     * Throws std::invalid_argument exception if the file could not be read.
+     */
+    mapped_file(const std::string &path);
+    mapped_file(mapped_file &&other) noexcept;
+    mapped_file(const mapped_file &)            = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+    mapped_file &operator=(mapped_file &&)      = delete;
+    ~mapped_file();
+
+    char *data() const;
+    size_t size() const;
+};
+
+/**
+ * find_special
+ *
+ * Returns the position of the first whitespace, quote or backslash in `data`,
+ * or `size` if there is none. Blocks of 16 or 32 bytes are checked at once
+ * where SSE2, AVX2 or NEON is available.
+ */
+size_t find_special(const char *data, size_t size);
+
+/**
+ * tokenize_response_file
+ *
+ * Split contents of a response file to arguments and append them to `args`.
+ *
+ * Arguments are separated by whitespace. Whitespace can be included in an
+ * argument by quoting it with `'` or `"`, or by escaping it with `\`. Inside
+ * double quotes `\` escapes the following character. Quotes and escapes are
+ * removed in place, so all views point into `data`. Data is only written to
+ * when an argument contains quotes or escapes.
+ *
+ * Throws std::invalid_argument exception on unterminated quote.
+ */
+void tokenize_response_file(char *data, size_t size,
+                            std::pmr::vector<std::string_view> &args);
+
+/**
+ * parse_config
+ *
+ * Call `entry(key, value, has_value)` for every line of config file `data`
+ * in form `key = value`, or just `key`. Whitespace around keys and values is
+ * removed, as well as double or single quotes around values. Empty lines and
+ * lines starting with `#` or `;` are skipped.
+ */
+template <class Fn>
+void parse_config(std::string_view data, Fn &&entry);
+
+/**
+ * append_help_line
+ *
+ * Append one aligned entry of help to `out`, see argp::help_string.
+ */
+void append_help_line(std::string &out, std::string_view first,
+                      std::string_view second, size_t min_w, size_t width,
+                      char fill = ' ');
+
+/**
+ * append_wrapped
+ *
+ * Append `line` wrapped at spaces to lines of at most `text_w` characters,
+ * continuation lines are indented by `indent` spaces. Words longer than
+ * `text_w` are not split.
+ */
+void append_wrapped(std::string &out, std::string_view line, size_t indent,
+                    size_t text_w);
+
+/**
+ * append_shell_quoted
+ *
+ * Append `str` in single quotes to `out`, so any shell takes it literally.
+ * Line breaks are replaced by spaces.
+ */
+void append_shell_quoted(std::string &out, std::string_view str);
+
+class indented
+{
+ private:
+    std::string_view str;
+    size_t width;
+    char fill;
+
+ public:
+    indented(std::string_view str, size_t width, char fill = ' ');
+
+    friend std::ostream &operator<<(std::ostream &os, const indented &val);
+};
+
+} // namespace impl
+
+namespace instrument
+{
+
+/**
+ * Function returning the number of allocations done by the program so far.
+ * The library does not replace operator new itself, set this to a function
+ * reading your own counter to get allocation counts in ParseStats.
+ */
+inline size_t (*allocation_counter)() = nullptr;
+
+/**
+ * allocations
+ *
+ * Returns value of allocation_counter, or 0 if it is not set.
+ */
+size_t allocations();
+
+} // namespace instrument
+
+/**
+ * Statistics of the last call to Parser::parse. Times, allocations and
+ * conversions are collected if ARGP_INSTRUMENT macro is defined before
+ * including this header, or at run time in profile mode (see
+ * Parser::PROFILE). Counters of matching (match_attempts, index_lookups and
+ * matches_calls) are in the hot path, so they are collected only with the
+ * macro, otherwise they stay zero and `counted` is false. The types are the
+ * same either way, but the macro should be defined in all translation units
+ * or in none, so all of them count.
+ * Parser of a Schema collects them only if the PROFILE flag is given.
+ *
+ * Description of fields:
+ * arguments - number of arguments parsed, after response files expansion
+ * match_attempts - number of arguments that had to be matched to an option
+ * index_lookups - number of lookups in the identifier hash table
+ * matches_calls - number of calls of virtual matches method
+ * allocations - allocations done during parse
+ *   (see instrument::allocation_counter)
+ * parse_time - total time spent in parse
+ * tokenize_time - time spent reading arguments and expanding response files
+ * match_time - time spent in neither tokenization nor conversion, which is
+ *   mostly matching arguments to options
+ * options - statistics of conversions, in the same order as the options
+ *   given to Parser. Allocations are not counted for batches converted by
+ *   multiple threads in PARALLEL_CONVERSION mode.
+ * counted - true if the counters of matching were collected
+ */
+struct ParseStats
+{
+    struct option_stats
+    {
+        size_t conversions;
+        size_t allocations;
+        std::chrono::nanoseconds conversion_time;
+    };
+
+    size_t arguments;
+    size_t match_attempts;
+    size_t index_lookups;
+    size_t matches_calls;
+    size_t allocations;
+    std::chrono::nanoseconds parse_time;
+    std::chrono::nanoseconds tokenize_time;
+    std::chrono::nanoseconds match_time;
+    std::vector<option_stats> options;
+    bool counted;
+
+    /**
+     * reset
+     *
+     * Set all counters to zero, for `option_count` options.
+     */
+    void reset(size_t option_count);
+};
+
+/**
+ * profile_report
+ *
+ * Returns `stats` of parsing `opts` as text table, or as a JSON object if
+ * `json` is true. Options are sorted by conversion time, slowest first, and
+ * options that were not converted are left out.
+ */
+std::string profile_report(const ParseStats &stats, const OptionsList &opts,
+                           bool json = false);
+
+namespace impl
+{
+
+/**
+ * Measures time and allocations of a conversion and adds them to `stats`.
+ * Does nothing if `stats` is nullptr, so it costs only a branch when stats
+ * are not collected.
+ */
+class conversion_timer
+{
+ private:
+    ParseStats::option_stats *stats;
+    std::chrono::steady_clock::time_point start;
+    size_t allocs;
+
+ public:
+    conversion_timer(ParseStats::option_stats *stats);
+
+    /**
+     * stop
+     *
+     * Add the time and allocations since construction to stats, as
+     * `conversions` conversions.
+     */
+    void stop(size_t conversions);
+};
+
+} // namespace impl
+
+/**
+ * Exception thrown by Parser when an abbreviated identifier is a prefix of
+ * identifiers of more than one option.
+ */
+class AmbiguousOptionError : public std::invalid_argument
+{
+ protected:
+    std::vector<std::string> candidates;
+
+ public:
+    AmbiguousOptionError(std::string_view arg,
+                         std::vector<std::string> candidates);
+
+    /**
+     * get_candidates
+     *
+     * Returns all identifiers starting with the abbreviation.
+     */
+    const std::vector<std::string> &get_candidates() const;
+};
+
+/**
+ * Arguments not recognised by Parser::parse_views.
+ *
+ * Views in args point into argv, or into memory-mapped response files, which
+ * are kept in files, so they remain valid as long as this object and argv.
+ * All memory is allocated from the memory resource given to parse_views.
+ */
+struct unrecognised_views
+{
+    std::pmr::vector<std::string_view> args;
+    std::pmr::vector<impl::mapped_file> files;
+
+    unrecognised_views(std::pmr::memory_resource *resource);
+
+    const std::string_view *begin() const;
+    const std::string_view *end() const;
+    size_t size() const;
+    bool empty() const;
+    const std::string_view &operator[](size_t i) const;
+};
+
+/**
+ * Result of Parser::parse_into, that does not depend on the state of the
+ * options, so it tells which options were given in this call even if the
+ * options were set before. A default constructed result has no options set.
+ */
+struct parse_result
+{
+    std::vector<std::string> unrecognised;
+
+    /// indices of the options given in the call, as in Parser::get_options
+    impl::option_set given;
+
+    /// options of the parser which produced this result
+    const OptionsList *options = nullptr;
+
+    /**
+     * is_set
+     *
+     * Returns true if `opt` was given in the call.
+     */
+    bool is_set(const OptionBase *opt) const;
+};
+
+/**
+ * Additional sources of option values for Parser::parse_layered.
+ */
+struct layered_sources
+{
+    /// Prefix of environment variables, no variables are read if empty.
+    std::string env_prefix;
+
+    /// Path of the config file, no file is read if empty.
+    std::string config_file;
+};
+
+/**
+ * This class prepares a list of options for parsing. The options are split to
+ * keyword and positional ones only once, when the parser is constructed, and
+ * this state is then reused for every argument and every call to parse.
+ *
+ * Identifiers of keyword options that report has_exact_identifiers are stored
+ * in a hash table, so matching them does not depend on the number of options.
+ * Other keyword options are still asked by calling their matches method, in
+ * the order in which they were given.
+ *
+ * The parser does not take ownership of the options, they must outlive it and
+ * their identifiers must not change.
+ */
+class Parser
+{
+ public:
+    /**
+     * Flags modifying behaviour of the parser. They can be combined with `|`.
+     *
+     * RESPONSE_FILES - arguments in form `@path` are replaced by arguments
+     *   read from the file at `path` (see impl::tokenize_response_file).
+     *   If the file can't be read, the argument is kept as it is. Response
+     *   files can reference other response files, up to
+     *   MAX_RESPONSE_FILE_DEPTH levels and MAX_RESPONSE_FILES files read in
+     *   one parse, otherwise std::invalid_argument is thrown. The file is
+     *   memory-mapped and the arguments point into the mapping, so options
+     *   must not keep views of their parameters after parse returns.
+     *
+     * ABBREVIATIONS - an argument starting with `--`, that does not match any
+     *   identifier exactly, matches the option with an identifier starting
+     *   with it, e.g. `--verb` matches `--verbose`. If identifiers of more
+     *   than one option start with it, AmbiguousOptionError is thrown. Only
+     *   identifiers starting with `--` of options with has_exact_identifiers
+     *   can be abbreviated.
+     *
+     * INLINE_VALUES - an argument in form `<identifier>=<value>`, that does
+     *   not match any identifier exactly, is matched as `<identifier>` and
+     *   `<value>` is passed as the first parameter of the option. If the
+     *   option does not take parameters, std::invalid_argument is thrown.
+     *
+     * BUNDLED_FLAGS - an argument in form `-xyz`, that does not match any
+     *   identifier exactly, is matched as `-x -y -z`, if all of them are
+     *   identifiers of options without parameters. The last option can take
+     *   parameters, then the rest of the argument is its first parameter
+     *   (`-vn5` is `-v -n 5`), or if it is the last character, its parameters
+     *   are taken from the following arguments (`-vn 5`). Only identifiers of
+     *   options with has_exact_identifiers can be bundled.
+     *
+     * PARALLEL_CONVERSION - parse in two phases. First, all arguments are
+     *   matched sequentially and parameters of keyword options are only
+     *   recorded. Then the recorded parameters are converted, different
+     *   options concurrently (see set_threads and OptionBase::parse_batch).
+     *   Occurrences of one option are always applied in their order.
+     *   Options whose converts_in_parallel returns false, e.g.
+     *   CallbackOption, are not recorded and are parsed sequentially.
+     *   Positional options are still parsed immediately, because matching
+     *   them depends on which of them are already set. If conversions fail,
+     *   the exception of the earliest failing argument is rethrown, but
+     *   options not depending on it may already be set.
+     *
+     * PROFILE - collect ParseStats and write profile_report of every parse to
+     *   stderr. It can also be enabled without changing the program by
+     *   setting environment variable PROFILE_ENV to `1` (text report) or
+     *   `json`. Counters of matching are only collected if ARGP_INSTRUMENT is
+     *   defined, timings always. Schema ignores the environment variable.
+     *
+     * REQUIRED_POSITIONALS - positional options constructed with is_required
+     *   are required as if they were passed to add_required. Without it,
+     *   is_required only changes the help.
+     */
+    enum Flags : unsigned
+    {
+        NONE                 = 0,
+        RESPONSE_FILES       = 1u << 0,
+        ABBREVIATIONS        = 1u << 1,
+        INLINE_VALUES        = 1u << 2,
+        BUNDLED_FLAGS        = 1u << 3,
+        PARALLEL_CONVERSION  = 1u << 4,
+        PROFILE              = 1u << 5,
+        REQUIRED_POSITIONALS = 1u << 6
+    };
+
+    /**
+     * Maximal depth of response files referencing other response files.
+     */
+    static constexpr int MAX_RESPONSE_FILE_DEPTH = 16;
+
+    /**
+     * Maximal number of response files read in one parse, so files
+     * referencing each other several times can't make it explode.
+     */
+    static constexpr size_t MAX_RESPONSE_FILES = 1024;
+
+    /**
+     * Minimal number of occurrences of a single option, for which its
+     * conversion gets more than one thread in PARALLEL_CONVERSION mode.
+     */
+    static constexpr size_t PARALLEL_MIN_OCCURRENCES = 1024;
+
+    /**
+     * Environment variable enabling profile reports, see PROFILE.
+     */
+    static constexpr const char *PROFILE_ENV = "ARGP_PROFILE";
+
+    /**
+     * Argument requesting completions from print_completions.
+     */
+    static constexpr std::string_view COMPLETE_ARG = "--argp-complete";
+
+    /**
+     * Shells supported by completion_script.
+     */
+    enum class Shell
+    {
+        BASH,
+        ZSH,
+        FISH
+    };
+
+ protected:
+    /**
+     * Value returned from match_option if no option matches.
+     */
+    static constexpr size_t NO_MATCH = static_cast<size_t>(-1);
+
+    /**
+     * Match recorded in the first phase of PARALLEL_CONVERSION mode.
+     *
+     * position - index of the matched argument
+     * offset, count - parameters of the option (identifier included), in the
+     *   parsed arguments, or in parse_state::deferred_params if pooled
+     */
+    struct deferred_match
+    {
+        size_t id;
+        size_t position;
+        size_t offset;
+        size_t count;
+        bool pooled;
+    };
+
+    /**
+     * State of a single call to parse, passed to all matching functions.
+     *
+     * args - all parsed arguments
+     * position - index of the argument being matched
+     * defer - true in PARALLEL_CONVERSION mode
+     */
+    struct parse_state
+    {
+        arg_span args;
+        size_t position;
+        bool defer;
+        std::vector<deferred_match> deferred;
+        std::vector<std::string_view> deferred_params;
+
+        /// positional options before this index are filled, see get_arity
+        size_t positional_cursor = 0;
+
+        /// options matched in this parse, nullptr if they are not tracked;
+        /// if tracked, positional options are matched by it instead of by
+        /// their is_set, so the result does not depend on the options state
+        impl::option_set *set_opts = nullptr;
+
+        /// if not nullptr, values are stored here instead of in the options,
+        /// which are then not modified at all
+        const impl::value_storage *storage = nullptr;
+
+        /// set when `unrecognised` callback returned true, see parse_args
+        bool stop = false;
+    };
+
+    /**
+     * Options are referenced by their index in the options field. Indices of
+     * keyword options are increasing, so they also keep the first-match-wins
+     * order between indexed and fallback options.
+     */
+    OptionsList options;
+    std::vector<split_options::Type> option_types;
+
+    /// keyword options recorded and converted later in PARALLEL_CONVERSION
+    impl::option_set parallel_opts;
+    unsigned flags;
+    size_t threads;
+    split_options split_opts;
+
+    /// options with exact identifiers, found by hash
+    impl::identifier_table keywords;
+
+    std::vector<size_t> keyword_fallback;
+    std::vector<size_t> positional_ids;
+    std::vector<PositionalOptionBase::Arity> positional_arities;
+
+    /**
+     * Entries of keywords with identifiers starting with `--` sorted
+     * alphabetically, so all identifiers with a common prefix form a
+     * continuous range. Entries are stored instead of views into the pool, so
+     * copies of Parser don't point into the original.
+     */
+    std::vector<size_t> long_identifiers;
+
+    struct short_option
+    {
+        size_t id;
+        int param_count;
+        /// entry of the identifier in keywords
+        size_t entry;
+    };
+
+    /**
+     * Options with single-character identifiers (`-x`) indexed by the
+     * character. It has 256 entries if BUNDLED_FLAGS is set, otherwise it is
+     * empty.
+     */
+    std::vector<short_option> short_options;
+
+    mutable ParseStats stats;
+
+    enum class ProfileFormat
+    {
+        NONE,
+        TEXT,
+        JSON
+    };
+
+    /// set from PROFILE flag and PROFILE_ENV in the constructor
+    ProfileFormat profile_format;
+
+    /// true if stats are collected, in profile mode or with ARGP_INSTRUMENT
+    bool collect_stats;
+
+    /**
+     * env_profile_format
+     *
+     * Returns the format requested by PROFILE_ENV. The environment is read
+     * only on the first call, so constructing parsers does not repeat it.
+     */
+    static ProfileFormat env_profile_format();
+
+    /**
+     * stats_of
+     *
+     * Returns stats of option `id` if stats are collected, otherwise nullptr.
+     */
+    ParseStats::option_stats *stats_of(size_t id) const;
+
+    /**
+     * count
+     *
+     * Increment `counter` of the stats if they are collected.
+     */
+    void count(size_t ParseStats::*counter) const;
+
+    /**
+     * finish_stats
+     *
+     * Fill totals of stats at the end of parse and write the profile report
+     * if it is enabled.
+     */
+    void finish_stats(size_t arguments, size_t allocs_start,
+                      std::chrono::steady_clock::time_point start) const;
+
+    /// constraints checked after parsing, see check_constraints
+    impl::option_set required_opts;
+    std::vector<impl::option_set> exclusive_groups;
+    std::vector<std::pair<size_t, impl::option_set>> dependencies;
+
+    /// help rendered by the last call to help, with its parameters
+    mutable std::string help_cache;
+    mutable std::string help_cmd;
+    mutable size_t help_min_w;
+    mutable size_t help_width;
+
+    /**
+     * match_option
+     *
+     * Find the option matching the argument, same as impl::match_option, but
+     * using the prepared identifier index.
+     *
+     * return value:
+     * - index of the matching option or NO_MATCH
+     */
+    size_t match_option(std::string_view arg) const;
+
+    /**
+     * match_keyword
+     *
+     * First part of match_option, that only tries keyword options.
+     */
+    size_t match_keyword(std::string_view arg) const;
+
+    /**
+     * match_positional
+     *
+     * Second part of match_option, that only tries positional options,
+     * starting at `cursor`. The cursor is moved past the options with SINGLE
+     * arity, which are already set. If `given` is not nullptr, it tells which
+     * options are set instead of OptionBase::is_set.
+     */
+    size_t match_positional(std::string_view arg, size_t &cursor,
+                            const impl::option_set *given) const;
+
+    /**
+     * dispatch_list
+     *
+     * Parse `args[i]` and the following arguments, that are not keywords, by
+     * option `id` of LIST arity.
+     */
+    void dispatch_list(size_t id, size_t &i, arg_span args,
+                       const parse_state &state) const;
+
+    /**
+     * prefix_range
+     *
+     * Returns the range of long_identifiers starting with `prefix`.
+     */
+    std::pair<const size_t *, const size_t *> prefix_range(
+        std::string_view prefix) const;
+
+    /**
+     * match_abbreviation
+     *
+     * Returns the keywords entry of a long identifier starting with
+     * `prefix`, or NO_ENTRY, see ABBREVIATIONS flag. If several identifiers
+     * of one option start with it, the first of them is returned.
+     */
+    size_t match_abbreviation(std::string_view prefix) const;
+
+    /**
+     * match_extended
+     *
+     * Try matching args[i] as an abbreviation or with an inline value,
+     * according to the flags, and handle the match.
+     *
+     * return value:
+     * - true if the argument was matched and handled
+     */
+    bool match_extended(size_t &i, arg_span args, parse_state &state) const;
+
+    /**
+     * match_bundle
+     *
+     * Try matching args[i] as bundled single-character options, see
+     * BUNDLED_FLAGS flag, and handle the match.
+     *
+     * return value:
+     * - true if the argument was matched and handled
+     */
+    bool match_bundle(size_t &i, arg_span args, parse_state &state) const;
+
+    /**
+     * dispatch
+     *
+     * Pass arguments to the option matched at args[i], see impl::handle_match,
+     * or record them for later conversion if state.defer is set.
+     */
+    void dispatch(size_t id, size_t &i, arg_span args,
+                  parse_state &state) const;
+
+    /**
+     * dispatch_as
+     *
+     * Same as dispatch, but the option gets `identifier` instead of args[i]
+     * and, if `value` is not null, it is used as its first parameter. Other
+     * parameters are taken from the arguments following args[i].
+     */
+    void dispatch_as(size_t id, std::string_view identifier,
+                     const std::string_view *value, size_t &i, arg_span args,
+                     parse_state &state) const;
+
+    /**
+     * convert_deferred
+     *
+     * Second phase of PARALLEL_CONVERSION mode, converts all matches recorded
+     * in `state`.
+     */
+    void convert_deferred(parse_state &state) const;
+
+    /**
+     * parse_arg
+     *
+     * Match argument `args[i]` and its parameters, moving `i` to the last
+     * consumed argument, or call `unrecognised` with it if it does not match.
+     */
+    template <class Fn>
+    void parse_arg(size_t &i, arg_span args, parse_state &state,
+                   Fn &&unrecognised) const;
+
+    /**
+     * parse_args
+     *
+     * Match all arguments in `args` and call `unrecognised` with each of the
+     * arguments that were not matched. Matched options are added to
+     * `set_opts`, if it is not nullptr.
+     *
+     * If `unrecognised` returns bool and it returns true, parsing stops and
+     * all following arguments are passed to it without being matched.
+     */
+    template <class Fn>
+    void parse_args(arg_span args, impl::option_set *set_opts,
+                    Fn &&unrecognised,
+                    const impl::value_storage *storage = nullptr) const;
+
+    /**
+     * find_id
+     *
+     * Returns index of `opt` in the options of this parser. Throws
+     * std::invalid_argument exception if it is not there.
+     */
+    size_t find_id(const OptionBase *opt) const;
+
+    /**
+     * has_constraints
+     *
+     * Returns true if any constraint was added, so matched options must be
+     * tracked.
+     */
+    bool has_constraints() const;
+
+    /**
+     * check_constraints
+     *
+     * Throws std::invalid_argument exception if options in `set_opts` violate
+     * any constraint.
+     */
+    void check_constraints(const impl::option_set &set_opts) const;
+
+    /**
+     * lookahead
+     *
+     * Returns the maximal number of parameters of an option, or
+     * static_cast<size_t>(-1) if an option takes all remaining arguments.
+     */
+    size_t lookahead() const;
+
+    /**
+     * add_arg
+     *
+     * Append argument to `args`, expanding it if it references a response
+     * file. Mapped files are stored in `files`, they must be kept until the
+     * arguments are parsed.
+     */
+    void add_arg(std::string_view arg, std::pmr::vector<std::string_view> &args,
+                 std::pmr::vector<impl::mapped_file> &files, int depth) const;
+
+    /**
+     * parse_argv
+     *
+     * Common implementation of parse methods. Converts argv to views
+     * allocated from `resource` and parses them, see parse_args.
+     */
+    template <class Fn>
+    void parse_argv(int argc, const char *argv[], int skip_first_n,
+                    std::pmr::vector<impl::mapped_file> &files,
+                    std::pmr::memory_resource *resource,
+                    impl::option_set *set_opts, Fn &&unrecognised,
+                    const impl::value_storage *storage = nullptr) const;
+
+    /**
+     * apply_value
+     *
+     * Parse `value` from environment or config file by option `id`. Options
+     * without parameters are set if the value is "1", "true", "yes" or "on"
+     * (or missing), and left unset if it is "0", "false", "no" or "off".
+     */
+    void apply_value(size_t id, std::string_view value, bool has_value,
+                     impl::option_set *set_opts) const;
+
+    /**
+     * parse_until
+     *
+     * Same as parse, but stops at the first unrecognised argument for which
+     * `is_end` returns true. That argument and all following ones are stored
+     * to `rest` without being parsed.
+     */
+    template <class Pred>
+    std::vector<std::string> parse_until(int argc, const char *argv[],
+                                         int skip_first_n, Pred &&is_end,
+                                         std::vector<std::string> &rest) const;
+
+ public:
+    friend class Schema;
+    friend class SubcommandParser;
+
+    Parser(OptionsList options, unsigned flags = NONE);
+
+    /**
+     * parse
+     *
+     * Parse string array according to the options given to the constructor.
+     * See argp::parse for the description of parameters and return value.
+     */
+    std::vector<std::string> parse(int argc, const char *argv[],
+                                   int skip_first_n = 1) const;
+
+    /**
+     * parse_views
+     *
+     * Same as parse, but unrecognised arguments are returned as views instead
+     * of copies, and all memory used by the parser during this call is
+     * allocated from `resource`. Passing for example
+     * std::pmr::monotonic_buffer_resource allows releasing all of it at once.
+     */
+    unrecognised_views parse_views(
+        int argc, const char *argv[], int skip_first_n = 1,
+        std::pmr::memory_resource *resource =
+            std::pmr::get_default_resource()) const;
+
+    /**
+     * parse_into
+     *
+     * Same as parse, but the options given in this call and the unrecognised
+     * arguments are stored in `res`. Reusing one result object for repeated
+     * calls reuses its memory.
+     *
+     * Values are still stored in the options, so calls must not run
+     * concurrently even with different results. Use Schema to parse from
+     * many threads at once.
+     */
+    void parse_into(parse_result &res, int argc, const char *argv[],
+                    int skip_first_n = 1) const;
+
+    /**
+     * parse_layered
+     *
+     * Same as parse, but options not given in argv are then looked up in the
+     * environment and in the config file, in this order of priority. Only the
+     * winning value of each option is converted.
+     *
+     * Environment variable of identifier `--dry-run` with prefix `TOOL_` is
+     * `TOOL_DRY_RUN`. Config file keys are identifiers without the leading
+     * `--` (or full identifiers), see impl::parse_config for the format. Keys
+     * that do not match any option are returned with unrecognised arguments.
+     * Options taking more than one parameter can be given only in argv.
+     */
+    std::vector<std::string> parse_layered(int argc, const char *argv[],
+                                           const layered_sources &sources,
+                                           int skip_first_n = 1) const;
+
+    /**
+     * parse
+     *
+     * Parse arguments from range [first, last) of values convertible to
+     * std::string_view, for example std::string. See parse_stream.
+     */
+    template <class It>
+    std::vector<std::string> parse(It first, It last) const;
+
+    /**
+     * parse_stream
+     *
+     * Parse arguments pulled one by one from `next`, a callable with signature
+     * `bool(std::string &token)` that stores the next argument to `token` and
+     * returns false when there are no more (see stream_tokens). Arguments are
+     * matched and converted as they arrive, only the arguments needed by the
+     * option with the most parameters are kept in memory (all remaining ones
+     * if an option takes them all).
+     *
+     * Arguments are released after they are parsed, lazy options keep their
+     * own copy of the parameter. RESPONSE_FILES and PARALLEL_CONVERSION flags
+     * are ignored.
+     */
+    template <class Source>
+    std::vector<std::string> parse_stream(Source &&next) const;
+
+    const OptionsList &get_options() const;
+
+    /**
+     * add_required
+     *
+     * Report an error from parse if `opt` is not given. Positional options
+     * constructed with is_required are required automatically only with the
+     * REQUIRED_POSITIONALS flag.
+     */
+    void add_required(const OptionBase *opt);
+
+    /**
+     * add_exclusive
+     *
+     * Report an error from parse if more than one of `opts` is given.
+     */
+    void add_exclusive(const OptionsList &opts);
+
+    /**
+     * add_dependency
+     *
+     * Report an error from parse if `opt` is given without all of `required`.
+     */
+    void add_dependency(const OptionBase *opt, const OptionsList &required);
+
+    /**
+     * help
+     *
+     * Returns help rendered by argp::help_string for the options of this
+     * parser. The result is cached until help is called with different
+     * parameters, so it must not be called from multiple threads at once.
+     */
+    const std::string &help(std::string_view cmd, size_t min_w = 25,
+                            size_t width = 0) const;
+
+    /**
+     * complete
+     *
+     * Returns identifiers of keyword options starting with `partial`, sorted
+     * alphabetically. Views point into the parser. Options with custom
+     * matching (see KeywordOptionBase::has_exact_identifiers) are not
+     * included.
+     */
+    std::vector<std::string_view> complete(std::string_view partial) const;
+
+    /**
+     * print_completions
+     *
+     * If the argument after the first `skip_first_n` is COMPLETE_ARG, write
+     * completions of the next argument (or of an empty one) to `os`, one per
+     * line, and return true. Otherwise return false. Call it before any other
+     * work, so the program can exit right after.
+     */
+    bool print_completions(int argc, const char *argv[], std::ostream &os,
+                           int skip_first_n = 1) const;
+
+    /**
+     * completion_script
+     *
+     * Returns a script for `shell` completing identifiers of keyword options
+     * of the program `cmd` with their help, and files otherwise. The script
+     * lists the options itself, so completing does not run the program.
+     */
+    std::string completion_script(std::string_view cmd, Shell shell) const;
+
+    /**
+     * validate_all
+     *
+     * Call validate on all options, forcing conversion of lazy options.
+     */
+    void validate_all() const;
+
+    /**
+     * reset
+     *
+     * Call reset on all options, so they can be parsed again as if they were
+     * just constructed.
+     */
+    void reset();
+
+    /**
+     * set_threads
+     *
+     * Set the maximal number of threads used in PARALLEL_CONVERSION mode.
+     * 0 (the default) means std::thread::hardware_concurrency.
+     */
+    void set_threads(size_t threads);
+
+    /**
+     * get_stats
+     *
+     * Returns statistics of the last call to parse, see ParseStats.
+     * Collecting them is not synchronised, so they are only meaningful if the
+     * parser is not used from multiple threads at once.
+     */
+    const ParseStats &get_stats() const;
+};
+
+/**
+ * parse
+ *
+ * Parse string array according to the options given in the argument.
+ *
+ * argc - number of c-style strings in argv
+ * argv - array of c-style strings to parse
+ *
+ * opts - vector of options to be parsed from the input
+ *
+ * skip_first_n - Ignore this number of strings at the start of argv.
+ *   Default value is set to 1 because C/C++ command line arguments
+ *   start with program name.
+ *
+ * flags - combination of Parser::Flags
+ *
+ * return - true if all arguments were recognised
+ *        - false if some arguments were not recognised (these can be
+ *          accessed by calling get_unrecognised method)
+ */
+std::vector<std::string> parse(int argc, const char *argv[],
+                               const OptionsList &opts, int skip_first_n = 1,
+                               unsigned flags = Parser::NONE);
+
+/**
+ * Source of arguments for Parser::parse_stream, reading tokens separated by
+ * `delimiter` from an input stream, by default null-delimited like the output
+ * of `find -print0` consumed by `xargs -0`.
+ */
+class stream_tokens
+{
+ private:
+    std::istream &is;
+    char delimiter;
+
+ public:
+    stream_tokens(std::istream &is, char delimiter = '\0');
+
+    bool operator()(std::string &token);
+};
+
+/**
+ * print_help
+ *
+ * Output help to a specified output stream. Identifiers are padded with
+ * `os.fill()` and the text is written by a formatted output operation.
+ *
+ * os - output stream
+ * cmd - command to be printed in the first line (`Usage: <cmd> <params>`)
+ * opts - options for which the help should be printed
+ * min_w - minimal number of characters that will be used to display
+ *   identifier of an option. Used for aligning help strings.
+ */
+void print_help(std::ostream &os, std::string_view cmd, const OptionsList &opts,
+                size_t min_w = 25);
+
+/**
+ * help_string
+ *
+ * Returns the same help as print_help. The text is written into one string
+ * reserved up front, so it is much faster for many options.
+ *
+ * width - if not 0, help strings are wrapped at spaces to fit into this
+ *   number of columns, for example terminal_width()
+ * fill - character used to pad identifiers to `min_w`
+ */
+std::string help_string(std::string_view cmd, const OptionsList &opts,
+                        size_t min_w = 25, size_t width = 0, char fill = ' ');
+
+/**
+ * terminal_width
+ *
+ * Returns number of columns from COLUMNS environment variable, or of the
+ * terminal connected to standard output on POSIX systems, or 0 if it is not
+ * known.
+ */
+size_t terminal_width();
+
+/**
+ * validate_all
+ *
+ * Call validate on all options, forcing conversion of lazy options. Throws
+ * the exception of the first option that fails.
+ */
+void validate_all(const OptionsList &opts);
+
+/**
+ * Base class for subcommands registered in SubcommandParser. Derived class
+ * owns its options, so they are constructed only when the subcommand is used.
+ */
+class Subcommand
+{
+ public:
+    virtual ~Subcommand() = default;
+
+    /**
+     * get_options
+     *
+     * Returns options of this subcommand. They must be valid until the object
+     * is destroyed.
+     */
+    virtual OptionsList get_options() = 0;
+
+    /**
+     * get_flags
+     *
+     * Returns Parser::Flags used for parsing arguments of this subcommand.
+     */
+    virtual unsigned get_flags() const;
+};
+
+/**
+ * Result of SubcommandParser::parse.
+ */
+struct subcommand_result
+{
+    /// Name of the selected subcommand, empty if none was given.
+    std::string name;
+
+    /// Selected subcommand with parsed options, nullptr if none was given.
+    std::unique_ptr<Subcommand> command;
+
+    /// Unrecognised arguments, both global and of the subcommand.
+    std::vector<std::string> unrecognised;
+};
+
+/**
+ * Parser of multi-tool command lines of form
+ * `<cmd> <global options> <subcommand> <subcommand options>`.
  *
- * argc - number of c-style strings in argv
- * argv - array of c-style strings to parse
+ * Subcommand is the first argument, that is not consumed by the global
+ * options and is equal to a registered name. Only options of the selected
+ * subcommand are constructed and searched, using their own Parser, so the
+ * cost of parsing does not depend on the number of subcommands. Global
+ * options are parsed from the arguments before the subcommand name.
+ */
+class SubcommandParser
+{
+ public:
+    using Factory = std::unique_ptr<Subcommand> (*)();
+
+ protected:
+    struct entry
+    {
+        std::string name;
+        std::string help;
+        Factory factory;
+    };
+
+    Parser global;
+
+    /// sorted by name
+    std::vector<entry> commands;
+
+    const entry *find(std::string_view name) const;
+
+ public:
+    SubcommandParser(OptionsList global_options = {},
+                     unsigned flags = Parser::NONE);
+
+    /**
+     * add
+     *
+     * Register subcommand `name`, created by `factory` when it is selected.
+     * Throws std::invalid_argument if the name is already registered.
+     */
+    void add(std::string name, std::string help, Factory factory);
+
+    /**
+     * add
+     *
+     * Register subcommand `name` of default constructible type Cmd.
+     */
+    template <class Cmd>
+    void add(std::string name, std::string help);
+
+    /**
+     * parse
+     *
+     * Parse global options, select the subcommand and parse its options. See
+     * argp::parse for the description of the parameters.
+     */
+    subcommand_result parse(int argc, const char *argv[],
+                            int skip_first_n = 1) const;
+
+    /**
+     * print_help
+     *
+     * Output global options and the list of subcommands, see argp::print_help.
+     */
+    void print_help(std::ostream &os, std::string_view cmd,
+                    size_t min_w = 25) const;
+};
+
+/**
+ * Typed index of a value in Schema and SchemaResult.
+ */
+template <class T>
+struct field
+{
+    size_t id;
+};
+
+namespace impl
+{
+
+/**
+ * value_slot of type T, holding the default value.
+ */
+template <class T>
+class typed_slot : public value_slot
+{
+ protected:
+    T default_val;
+
+ public:
+    typed_slot(T default_val);
+
+    T &at(unsigned char *values) const;
+
+    virtual size_t size() const override;
+    virtual size_t align() const override;
+    virtual void construct(unsigned char *values) const override;
+    virtual void assign_default(unsigned char *values) const override;
+    virtual void destroy(unsigned char *values) const override;
+};
+
+/**
+ * Options of Schema only provide identifiers, help and number of parameters
+ * to Parser, values are converted by value_slot::convert into the storage of
+ * SchemaResult. Calling from_string on them throws std::logic_error.
+ */
+template <class T>
+class schema_keyword : public KeywordOptionBase, public typed_slot<T>
+{
+ protected:
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+
+ public:
+    schema_keyword(std::vector<std::string> identifiers, std::string help,
+                   T default_val);
+
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view identifier) override;
+    virtual bool has_exact_identifiers() const override;
+    virtual void convert(arg_span args, unsigned char *values) const override;
+};
+
+template <class T>
+class schema_multi_keyword : public KeywordOptionBase,
+                             public typed_slot<std::vector<T>>
+{
+ protected:
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+
+ public:
+    schema_multi_keyword(std::vector<std::string> identifiers,
+                         std::string help);
+
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view identifier) override;
+    virtual bool has_exact_identifiers() const override;
+    virtual void convert(arg_span args, unsigned char *values) const override;
+};
+
+template <class T>
+class schema_positional : public PositionalOptionBase, public typed_slot<T>
+{
+ protected:
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+
+ public:
+    schema_positional(std::string name, std::string help, bool is_required,
+                      T default_val);
+
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view identifier) override;
+    virtual Arity get_arity() const override;
+    virtual void convert(arg_span args, unsigned char *values) const override;
+};
+
+template <class T>
+class schema_positional_list : public PositionalOptionBase,
+                               public typed_slot<std::vector<T>>
+{
+ protected:
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override;
+
+ public:
+    schema_positional_list(std::string name, std::string help,
+                           bool is_required);
+
+    virtual int get_param_count() override;
+    virtual bool matches(std::string_view identifier) override;
+    virtual Arity get_arity() const override;
+    virtual std::pair<std::string, std::string> get_help() const override;
+    virtual void convert(arg_span args, unsigned char *values) const override;
+};
+
+} // namespace impl
+
+/**
+ * Immutable description of options, that can be shared by any number of
+ * threads parsing at once. Parsed values are stored in SchemaResult, in one
+ * flat buffer indexed by option id, instead of in the options.
  *
- * opts - vector of options to be parsed from the input
+ * Exceptions to that are the mutable parts of the underlying Parser:
+ * ParseStats are written by every parse when they are collected, and
+ * Parser::help caches its result. A schema collects stats only if it is
+ * constructed with Parser::PROFILE, PROFILE_ENV and ARGP_INSTRUMENT are
+ * ignored, so don't pass that flag to a schema parsed from multiple threads.
+ * Call help or modify the parser returned by get_parser only while no thread
+ * is parsing.
  *
- * skip_first_n - Ignore this number of strings at the start of argv.
- *   Default value is set to 1 because C/C++ command line arguments
- *   start with program name.
+ * Usage:
+ *   argp::Schema schema;
+ *   auto jobs = schema.keyword<int>({"-j", "--jobs"}, "Job count.", 1);
+ *   auto files = schema.positional_list<std::string>("files", "Inputs.");
+ *   schema.compile();
+ *   // in any thread
+ *   argp::SchemaResult res = schema.parse(argc, argv);
+ *   int n = res.get(jobs);
+ */
+class Schema
+{
+ protected:
+    unsigned flags;
+    std::vector<std::unique_ptr<OptionBase>> owned;
+    std::vector<const impl::value_slot *> slots;
+
+    /// size of the storage in bytes
+    size_t storage_size;
+
+    /// nullptr until compile is called
+    std::unique_ptr<Parser> parser;
+
+    template <class V, class Option>
+    field<V> add(std::unique_ptr<Option> option);
+
+    /**
+     * prepare
+     *
+     * Make `res` hold default values of this schema, reusing its memory if
+     * it was already used with this schema.
+     */
+    void prepare(SchemaResult &res) const;
+
+ public:
+    /**
+     * flags - combination of Parser::Flags, PARALLEL_CONVERSION is ignored
+     */
+    Schema(unsigned flags = Parser::NONE);
+
+    /**
+     * keyword
+     *
+     * Add keyword option with one parameter, or none for bool.
+     */
+    template <class T>
+    field<T> keyword(std::vector<std::string> identifiers, std::string help,
+                     T val = T());
+
+    /**
+     * multi_keyword
+     *
+     * Add keyword option collecting the parameter of every occurrence.
+     */
+    template <class T>
+    field<std::vector<T>> multi_keyword(std::vector<std::string> identifiers,
+                                        std::string help);
+
+    template <class T>
+    field<T> positional(std::string name, std::string help, bool is_required,
+                        T val = T());
+
+    /**
+     * positional_list
+     *
+     * Add positional option collecting all remaining positional arguments.
+     */
+    template <class T>
+    field<std::vector<T>> positional_list(std::string name, std::string help,
+                                          bool is_required = false);
+
+    /**
+     * compile
+     *
+     * Build the parser, after that no options can be added and parse can be
+     * called. Throws std::logic_error if called twice.
+     */
+    void compile();
+
+    /**
+     * parse_into
+     *
+     * Parse arguments into `res`, see argp::parse. Safe to call from multiple
+     * threads at once with different results, unless the schema was
+     * constructed with Parser::PROFILE. Throws std::logic_error if compile
+     * was not called.
+     */
+    void parse_into(SchemaResult &res, int argc, const char *argv[],
+                    int skip_first_n = 1) const;
+
+    SchemaResult parse(int argc, const char *argv[],
+                       int skip_first_n = 1) const;
+
+    /**
+     * get_parser
+     *
+     * Returns the compiled parser, for example to print help or add
+     * constraints. Its help cache and constraints are not synchronised, use
+     * them only while no thread is parsing. Throws std::logic_error if
+     * compile was not called.
+     */
+    Parser &get_parser();
+    const Parser &get_parser() const;
+};
+
+/**
+ * Values parsed by Schema. The schema must outlive its results.
+ */
+class SchemaResult
+{
+ protected:
+    friend class Schema;
+
+    const Schema *schema;
+    const std::vector<const impl::value_slot *> *slots;
+    std::vector<std::max_align_t> storage;
+    impl::option_set given;
+
+    unsigned char *values() const;
+    void destroy();
+
+ public:
+    std::vector<std::string> unrecognised;
+
+    SchemaResult();
+    SchemaResult(SchemaResult &&other) noexcept;
+    SchemaResult &operator=(SchemaResult &&other) noexcept;
+    SchemaResult(const SchemaResult &)            = delete;
+    SchemaResult &operator=(const SchemaResult &) = delete;
+    ~SchemaResult();
+
+    template <class T>
+    const T &get(field<T> f) const;
+
+    template <class T>
+    T &get(field<T> f);
+
+    /**
+     * is_set
+     *
+     * Returns true if the option was given.
+     */
+    template <class T>
+    bool is_set(field<T> f) const;
+};
+
+namespace impl
+{
+
+/**
+ * Type used by static options to store their default value. It must be usable
+ * in constant expressions, so std::string defaults are stored as views.
+ */
+template <class T>
+using static_default_t =
+    std::conditional_t<std::is_same_v<T, std::string>, std::string_view, T>;
+
+} // namespace impl
+
+/**
+ * Compile-time description of a keyword option used by StaticParser. It has
+ * the same meaning as KeywordOption, but its identifiers are stored in
+ * a fixed-size array, so the whole option table can be constexpr.
  *
- * return - true if all arguments were recognised
- *        - false if some arguments were not recognised (these can be
- *          accessed by calling get_unrecognised method)
+ * Use static_keyword function to create it.
  */
-std::vector<std::string> parse(int argc, const char *argv[],
-                               const OptionsList &opts, int skip_first_n = 1);
+template <class T, size_t N>
+struct StaticKeywordOption
+{
+    using value_type = T;
+
+    static constexpr bool IS_KEYWORD = true;
+    static constexpr int NUM_OPTS    = std::is_same_v<T, bool> ? 0 : 1;
+
+    std::array<std::string_view, N> identifiers;
+    std::string_view help;
+    impl::static_default_t<T> default_val;
+
+    constexpr bool matches(std::string_view identifier) const;
+};
 
 /**
- * print_help
+ * Compile-time description of a positional option used by StaticParser. It has
+ * the same meaning as PositionalOption.
+ *
+ * Use static_positional function to create it.
+ */
+template <class T>
+struct StaticPositionalOption
+{
+    using value_type = T;
+
+    static constexpr bool IS_KEYWORD = false;
+    static constexpr int NUM_OPTS    = 0;
+
+    std::string_view name;
+    std::string_view help;
+    bool is_required;
+    impl::static_default_t<T> default_val;
+};
+
+/**
+ * static_keyword
  *
- * Output help to a specified output stream.
+ * Create a compile-time keyword option.
  *
- * os - output stream
- * cmd - command to be printed in the first line (`Usage: <cmd> <params>`)
- * opts - options for which the help should be printed
- * min_w - minimal number of characters that will be used to display
- *   identifier of an option. Used for aligning help strings.
+ * Example: `static_keyword<int>({"-n", "--count"}, "number of runs", 1)`
  */
-void print_help(std::ostream &os, std::string_view cmd, const OptionsList &opts,
-                size_t min_w = 25);
+template <class T, size_t N>
+constexpr StaticKeywordOption<T, N> static_keyword(
+    const std::string_view (&identifiers)[N], std::string_view help,
+    impl::static_default_t<T> val = impl::static_default_t<T>());
+
+/**
+ * static_positional
+ *
+ * Create a compile-time positional option.
+ */
+template <class T>
+constexpr StaticPositionalOption<T> static_positional(
+    std::string_view name, std::string_view help, bool is_required,
+    impl::static_default_t<T> val = impl::static_default_t<T>());
+
+/**
+ * This class is a compile-time alternative to Parser. All options are known
+ * in the template parameters, so matching is expanded to a sequence of
+ * comparisons against constant identifiers and conversions are called without
+ * virtual dispatch. The option table itself does not allocate any memory.
+ *
+ * Parsed values are not stored in the options, but returned from parse in
+ * a Result object and accessed by the index of the option.
+ *
+ * Example:
+ * ```
+ * constexpr argp::StaticParser parser(
+ *     argp::static_keyword<bool>({"-v", "--verbose"}, "verbose output"),
+ *     argp::static_positional<std::string>("file", "input file", true));
+ * auto result = parser.parse(argc, argv);
+ * bool verbose = result.get<0>();
+ * ```
+ *
+ * Matching follows the same rules as Parser: all keyword options are tried
+ * first, then the first positional option that was not set yet is used.
+ */
+template <class... Opts>
+class StaticParser
+{
+ public:
+    using values_type = std::tuple<typename Opts::value_type...>;
+
+    struct Result
+    {
+        values_type values;
+        std::array<bool, sizeof...(Opts)> set_flags;
+        std::vector<std::string> unrecognised;
+
+        template <size_t I>
+        const std::tuple_element_t<I, values_type> &get() const;
+
+        template <size_t I>
+        bool is_set() const;
+    };
+
+ protected:
+    std::tuple<Opts...> opts;
+
+    template <size_t I>
+    bool try_keyword(std::string_view arg, int &i, int argc,
+                     const char *argv[], Result &res) const;
+
+    template <size_t I>
+    bool try_positional(std::string_view arg, Result &res) const;
+
+    template <size_t... I>
+    void parse_arg(int &i, int argc, const char *argv[], Result &res,
+                   std::index_sequence<I...>) const;
+
+    template <size_t... I>
+    Result make_result(std::index_sequence<I...>) const;
+
+ public:
+    constexpr StaticParser(Opts... opts);
+
+    /**
+     * parse
+     *
+     * Parse string array according to the options given to the constructor.
+     * The parameters have the same meaning as in argp::parse.
+     */
+    Result parse(int argc, const char *argv[], int skip_first_n = 1) const;
+
+    constexpr const std::tuple<Opts...> &get_options() const;
+};
 
 } // namespace argp
 
@@ -3,6 +3,18 @@
 
 #include "argparser.hpp"
 
+// platform headers are needed only by the definitions
+#if defined(__unix__) || defined(__APPLE__)
+#    define ARGP_HAS_MMAP 1
+#    include <fcntl.h>
+#    include <sys/ioctl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#else
+#    include <fstream>
+#endif
+
 namespace argp
 {
 
@@ -24,8 +36,50 @@ inline split_options::split_options(const OptionsList &options)
     }
 }
 
+inline constexpr arg_span::arg_span() : strings(nullptr), count(0) {}
+
+inline constexpr arg_span::arg_span(const std::string_view *strings,
+                                    size_t count)
+    : strings(strings), count(count)
+{
+}
+
+inline arg_span::arg_span(const std::vector<std::string_view> &strings)
+    : strings(strings.data()), count(strings.size())
+{
+}
+
+inline constexpr const std::string_view *arg_span::begin() const
+{
+    return this->strings;
+}
+
+inline constexpr const std::string_view *arg_span::end() const
+{
+    return this->strings + this->count;
+}
+
+inline constexpr size_t arg_span::size() const { return this->count; }
+
+inline constexpr bool arg_span::empty() const { return this->count == 0; }
+
+inline constexpr const std::string_view &arg_span::operator[](size_t i) const
+{
+    return this->strings[i];
+}
+
+inline constexpr arg_span arg_span::subspan(size_t offset, size_t count) const
+{
+    return arg_span(this->strings + offset, count);
+}
+
 inline OptionBase::OptionBase() : is_set_(false) {}
 
+inline void OptionBase::from_args(arg_span args)
+{
+    this->from_string(std::vector<std::string_view>(args.begin(), args.end()));
+}
+
 inline void OptionBase::parse(const std::vector<std::string_view> &strings)
 {
     this->from_string(strings);
@@ -33,12 +87,35 @@ inline void OptionBase::parse(const std::vector<std::string_view> &strings)
     is_set_ = true;
 }
 
+inline void OptionBase::parse(arg_span args)
+{
+    this->from_args(args);
+
+    is_set_ = true;
+}
+
+inline void OptionBase::parse_batch(const arg_span *occurrences, size_t count,
+                                    size_t, size_t &failed)
+{
+    for (size_t k = 0; k < count; k++)
+    {
+        failed = k;
+        this->parse(occurrences[k]);
+    }
+}
+
+inline bool OptionBase::converts_in_parallel() const { return true; }
+
+inline void OptionBase::validate() const {}
+
+inline void OptionBase::reset() { is_set_ = false; }
+
 inline bool OptionBase::is_set() const { return is_set_; }
 
 inline PositionalOptionBase::PositionalOptionBase(std::string name,
                                                   std::string help,
                                                   bool is_required)
-    : name(name), help(help), is_required(is_required)
+    : name(std::move(name)), help(std::move(help)), is_required(is_required)
 {
 }
 
@@ -54,23 +131,34 @@ inline split_options::Type PositionalOptionBase::get_type() const
     return split_options::Type::POSITIONAL;
 }
 
+inline PositionalOptionBase::Arity PositionalOptionBase::get_arity() const
+{
+    return CUSTOM;
+}
+
+inline bool PositionalOptionBase::get_required() const
+{
+    return this->is_required;
+}
+
 inline KeywordOptionBase::KeywordOptionBase(
     std::vector<std::string> identifiers, std::string help)
-    : identifiers(identifiers), help(help)
+    : identifiers(std::move(identifiers)), help(std::move(help))
 {
 }
 
 inline std::pair<std::string, std::string> KeywordOptionBase::get_help() const
 {
-    int length = std::accumulate(
-        this->identifiers.begin(), this->identifiers.end(), 0,
-        [](int length, std::string str) { return length + str.length() + 2; });
+    size_t length = std::accumulate(
+        this->identifiers.begin(), this->identifiers.end(), size_t(0),
+        [](size_t length, const std::string &str)
+        { return length + str.length() + 2; });
 
     std::string tmp;
     tmp.reserve(length);
 
     bool is_first = true;
-    for (auto str : this->identifiers)
+    for (const auto &str : this->identifiers)
     {
         if (is_first)
         {
@@ -91,257 +179,4592 @@ inline split_options::Type KeywordOptionBase::get_type() const
     return split_options::Type::KEYWORD;
 }
 
-template <class T>
-inline void PositionalOption<T>::from_string(
-    const std::vector<std::string_view> &strings)
-{
-    std::string str = std::string(strings[0]);
-    std::istringstream iss(str);
-    iss >> this->val;
-    if (!iss)
-    {
-        throw std::invalid_argument("Could not parse the data.");
-    }
-}
+inline bool KeywordOptionBase::has_exact_identifiers() const { return false; }
 
-template <>
-inline void PositionalOption<std::string>::from_string(
-    const std::vector<std::string_view> &strings)
+inline const std::vector<std::string> &KeywordOptionBase::get_identifiers()
+    const
 {
-    this->val = std::string(strings[0]);
+    return this->identifiers;
 }
 
-template <class T>
-inline PositionalOption<T>::PositionalOption(std::string name, std::string help,
-                                             bool is_required,
-                                             T val /* = T() */)
-    : PositionalOptionBase(name, help, is_required), val(val)
+inline bool KeywordOptionBase::has_identifier(std::string_view identifier) const
 {
-}
+    for (const auto &id : this->identifiers)
+    {
+        if (id == identifier)
+        {
+            return true;
+        }
+    }
 
-template <class T>
-inline int PositionalOption<T>::get_param_count()
-{
-    return 0;
+    return false;
 }
 
-template <class T>
-inline bool PositionalOption<T>::matches(std::string_view)
+namespace impl
 {
-    return !this->is_set();
-}
 
-template <class T>
-inline T PositionalOption<T>::get_val() const
+/**
+ * Number read by read_decimal, the fractional part is frac / frac_scale.
+ */
+struct decimal
 {
-    return this->val;
-}
+    uint64_t whole      = 0;
+    uint64_t frac       = 0;
+    uint64_t frac_scale = 1;
 
-template <class T>
-inline constexpr const int KeywordOption<T>::NUM_OPTS = 1;
-
-template <>
-inline constexpr const int KeywordOption<bool>::NUM_OPTS = 0;
-
-template <class T>
-inline void KeywordOption<T>::from_string(
-    const std::vector<std::string_view> &strings)
-{
-    std::string str = std::string(strings[1]);
-    std::istringstream iss(str);
-    iss >> this->val;
-    if (!iss)
+    long double value() const
     {
-        throw std::invalid_argument("Could not parse the data.");
+        return static_cast<long double>(this->whole) +
+               static_cast<long double>(this->frac) / this->frac_scale;
     }
-}
+};
 
-template <>
-inline void KeywordOption<std::string>::from_string(
-    const std::vector<std::string_view> &strings)
+/**
+ * read_decimal
+ *
+ * Read non-negative number in form `digits[.digits]` starting at `pos` and
+ * advance `pos` past it. Returns false if there are no digits or the whole
+ * part overflows. Fractional digits beyond 18 are ignored.
+ */
+inline bool read_decimal(std::string_view str, size_t &pos, decimal &num)
 {
-    this->val = std::string(strings[1]);
-}
+    size_t start = pos;
+    num          = decimal();
+    for (; pos < str.size() && str[pos] >= '0' && str[pos] <= '9'; pos++)
+    {
+        unsigned digit = static_cast<unsigned>(str[pos] - '0');
+        if (num.whole > (UINT64_MAX - digit) / 10)
+        {
+            return false;
+        }
+        num.whole = num.whole * 10 + digit;
+    }
 
-template <>
-inline void KeywordOption<bool>::from_string(
-    const std::vector<std::string_view> &)
-{
-    this->val = true;
-}
+    bool has_digits = pos > start;
+    if (pos < str.size() && str[pos] == '.')
+    {
+        pos++;
+        for (; pos < str.size() && str[pos] >= '0' && str[pos] <= '9'; pos++)
+        {
+            has_digits = true;
+            if (num.frac_scale < 1000000000000000000ull)
+            {
+                num.frac        = num.frac * 10 + (str[pos] - '0');
+                num.frac_scale *= 10;
+            }
+        }
+    }
 
-template <class T>
-inline KeywordOption<T>::KeywordOption(std::vector<std::string> identifiers,
-                                       std::string help, T val /* = T() */)
-    : KeywordOptionBase(identifiers, help), val(val)
-{
+    return has_digits;
 }
 
-template <class T>
-inline int KeywordOption<T>::get_param_count()
+template <class E, size_t N>
+inline constexpr std::array<std::pair<std::string_view, E>, N> sorted_names(
+    const std::pair<std::string_view, E> (&values)[N])
 {
-    return NUM_OPTS;
+    std::array<std::pair<std::string_view, E>, N> sorted{};
+    for (size_t i = 0; i < N; i++)
+    {
+        // insertion sort, neither std::sort nor assignment of std::pair is
+        // constexpr in C++17
+        size_t k = i;
+        for (; k > 0 && values[i].first < sorted[k - 1].first; k--)
+        {
+            sorted[k].first  = sorted[k - 1].first;
+            sorted[k].second = sorted[k - 1].second;
+        }
+        sorted[k].first  = values[i].first;
+        sorted[k].second = values[i].second;
+    }
+    return sorted;
 }
 
-template <class T>
-inline bool KeywordOption<T>::matches(std::string_view identifier)
+template <class E, size_t N>
+inline constexpr bool has_unique_names(
+    const std::array<std::pair<std::string_view, E>, N> &sorted)
 {
-    for (auto id : this->identifiers)
+    for (size_t i = 1; i < N; i++)
     {
-        if (id == identifier)
+        if (sorted[i - 1].first == sorted[i].first)
         {
-            return true;
+            return false;
         }
     }
-
-    return false;
+    return true;
 }
 
-template <typename T>
-inline T KeywordOption<T>::get_val() const
-{
-    return val;
-}
+} // namespace impl
 
-namespace impl
+inline void converter<byte_size>::convert(std::string_view str,
+                                          byte_size &val)
 {
+    size_t pos = 0;
+    impl::decimal num;
+    if (!impl::read_decimal(str, pos, num))
+    {
+        throw std::invalid_argument("Could not parse the data.");
+    }
 
-inline OptionBase *match_option(const char *arg, const OptionsList &opts)
-{
-    auto split_opts = split_options(opts);
+    // at most a prefix letter, `i` and `b`, compared in lower case
+    std::string_view rest = str.substr(pos);
+    char suffix_buf[3];
+    if (rest.size() > sizeof(suffix_buf))
+    {
+        throw std::invalid_argument("Could not parse the data.");
+    }
+    for (size_t k = 0; k < rest.size(); k++)
+    {
+        auto c        = static_cast<unsigned char>(rest[k]);
+        suffix_buf[k] = static_cast<char>(std::tolower(c));
+    }
+    std::string_view suffix(suffix_buf, rest.size());
 
-    for (auto opt : split_opts.keyword)
+    uint64_t base = 1024;
+    size_t power  = 0;
+    if (!suffix.empty() && suffix != "b")
     {
-        if (opt->matches(arg))
+        constexpr std::string_view prefixes = "kmgtpe";
+        size_t p                            = prefixes.find(suffix[0]);
+        std::string_view marker             = suffix.substr(1);
+        if (p == std::string_view::npos ||
+            (!marker.empty() && marker != "i" && marker != "ib" &&
+             marker != "b"))
         {
-            return opt;
+            throw std::invalid_argument("Could not parse the data.");
         }
+        base  = (marker == "b") ? 1000 : 1024;
+        power = p + 1;
     }
 
-    for (auto opt : split_opts.positional)
+    uint64_t multiplier = 1;
+    for (size_t k = 0; k < power; k++)
     {
-        if (opt->matches(arg))
-        {
-            return opt;
-        }
+        multiplier *= base;
     }
 
-    return nullptr;
+    if (num.whole > UINT64_MAX / multiplier)
+    {
+        throw std::invalid_argument("Could not parse the data.");
+    }
+
+    // the fraction is rounded down to whole bytes
+    uint64_t whole = num.whole * multiplier;
+    auto frac      = static_cast<uint64_t>(static_cast<long double>(num.frac) /
+                                           num.frac_scale * multiplier);
+    if (frac > UINT64_MAX - whole)
+    {
+        throw std::invalid_argument("Could not parse the data.");
+    }
+
+    val.bytes = whole + frac;
 }
 
-inline void handle_match(int &i, OptionBase *opt, int argc, const char *argv[])
+template <class Rep, class Period>
+inline void converter<std::chrono::duration<Rep, Period>>::convert(
+    std::string_view str, std::chrono::duration<Rep, Period> &val)
 {
-    int param_count = opt->get_param_count();
-    if (param_count < -1)
+    struct unit
     {
-        throw std::invalid_argument("Invalid number of requested parameters.");
+        std::string_view name;
+        intmax_t num;
+        intmax_t den;
+    };
+    static constexpr unit units[] = {
+        {"ns", 1, 1000000000}, {"us", 1, 1000000}, {"ms", 1, 1000},
+        {"s", 1, 1},           {"m", 60, 1},       {"min", 60, 1},
+        {"h", 3600, 1},        {"d", 86400, 1}};
+
+    if (str.empty())
+    {
+        throw std::invalid_argument("Could not parse the data.");
     }
 
-    if (param_count == -1)
+    long double total = 0;
+    bool has_units    = false;
+    size_t pos        = 0;
+    while (pos < str.size())
     {
-        param_count = argc - i - 1;
+        impl::decimal num;
+        if (!impl::read_decimal(str, pos, num))
+        {
+            throw std::invalid_argument("Could not parse the data.");
+        }
+
+        size_t unit_start = pos;
+        while (pos < str.size() &&
+               std::isalpha(static_cast<unsigned char>(str[pos])))
+        {
+            pos++;
+        }
+        std::string_view name = str.substr(unit_start, pos - unit_start);
+
+        // without unit the number is in units of the duration
+        long double ratio = 1;
+        if (!name.empty())
+        {
+            const unit *found = nullptr;
+            for (const unit &u : units)
+            {
+                found = (u.name == name) ? &u : found;
+            }
+            if (found == nullptr)
+            {
+                throw std::invalid_argument("Could not parse the data.");
+            }
+            ratio = static_cast<long double>(found->num) * Period::den /
+                    (static_cast<long double>(found->den) * Period::num);
+            has_units = true;
+        }
+        else if (pos < str.size() || has_units)
+        {
+            throw std::invalid_argument("Could not parse the data.");
+        }
+
+        total += num.value() * ratio;
     }
 
-    if (i + param_count >= argc)
+    if constexpr (std::is_floating_point_v<Rep>)
     {
-        throw std::out_of_range("Not enough arguments.");
+        val = std::chrono::duration<Rep, Period>(static_cast<Rep>(total));
+    }
+    else
+    {
+        // tolerate binary rounding of decimal fractions, e.g. 1.1s as ms
+        long double rounded = std::round(total);
+        if (std::fabs(total - rounded) > 1e-6L * std::max(1.0L, rounded) ||
+            rounded > static_cast<long double>(std::numeric_limits<Rep>::max()))
+        {
+            throw std::invalid_argument("Could not parse the data.");
+        }
+        val = std::chrono::duration<Rep, Period>(static_cast<Rep>(rounded));
     }
+}
 
-    std::vector<std::string_view> opts;
-    opts.reserve(param_count + 1);
+template <class E>
+inline void converter<E, std::enable_if_t<std::is_enum_v<E> &&
+                                          impl::has_enum_names<E>::value>>::
+    convert(std::string_view str, E &val)
+{
+    const auto &sorted = impl::enum_table<E>::sorted;
+    static_assert(impl::has_unique_names(impl::enum_table<E>::sorted),
+                  "enum_names has duplicate names");
 
-    for (int end = i + param_count + 1; i < end; i++)
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), str,
+                               [](const auto &entry, std::string_view str)
+                               { return entry.first < str; });
+    if (it == sorted.end() || it->first != str)
     {
-        opts.push_back(std::string_view(argv[i]));
+        throw std::invalid_argument("Could not parse the data.");
     }
-    --i;
 
-    opt->parse(opts);
+    val = it->second;
 }
 
-inline indented::indented(std::string_view str, size_t width,
-                          char fill /* = ' ' */)
-    : str(str), width(width), fill(fill)
+namespace impl
 {
-}
 
-inline std::ostream &operator<<(std::ostream &os, const indented &val)
+template <class T>
+inline void convert_number(std::string_view str, T &val)
 {
-    for (auto c : val.str)
+    const char *first = str.data();
+    const char *last  = str.data() + str.size();
+
+    // stream extraction accepts explicit plus sign, keep accepting it
+    if (first != last && *first == '+')
     {
-        os << c;
-        if (c == '\n' || c == '\r')
+        ++first;
+        if (first != last && *first == '-')
         {
-            for (size_t i = 0; i < val.width; i++)
-            {
-                os << val.fill;
-            }
+            throw std::invalid_argument("Could not parse the data.");
         }
     }
 
-    return os;
+    auto [ptr, ec] = std::from_chars(first, last, val);
+    if (ec != std::errc() || ptr != last)
+    {
+        throw std::invalid_argument("Could not parse the data.");
+    }
 }
 
-} // namespace impl
-
-inline std::vector<std::string> parse(int argc, const char *argv[],
-                                      const OptionsList &opts,
-                                      int skip_first_n /* = 1 */)
+template <class T>
+inline void convert(std::string_view str, T &val)
 {
-    std::vector<std::string> unrecognised;
-
-    for (int i = skip_first_n; i < argc; i++)
+    if constexpr (has_converter<T>::value)
     {
-        OptionBase *opt = impl::match_option(argv[i], opts);
-        if (opt != nullptr)
-        {
-            impl::handle_match(i, opt, argc, argv);
-        }
-        else
+        converter<T>::convert(str, val);
+    }
+    else if constexpr (is_from_chars_convertible<T>::value)
+    {
+        convert_number(str, val);
+    }
+    else if constexpr (is_char_string<T>::value)
+    {
+        val.assign(str.data(), str.size());
+    }
+    else
+    {
+        std::istringstream iss(std::string(str), std::ios_base::in);
+        iss >> val;
+        if (!iss)
         {
-            unrecognised.push_back(argv[i]);
+            throw std::invalid_argument("Could not parse the data.");
         }
-        continue;
     }
-
-    return unrecognised;
 }
 
-inline void print_help(std::ostream &os, std::string_view cmd,
-                       const OptionsList &opts, size_t min_w /* = 25 */)
+template <class T, class Container>
+inline T make_element(const Container &container)
 {
-    auto split_opts = split_options(opts);
-
-    auto flags = os.flags();
-    os << std::left;
-
-    os << "Usage: " << cmd;
-    if (split_opts.keyword.size() > 0)
+    if constexpr (has_allocator_type<Container>::value)
     {
-        os << " <options>";
+        if constexpr (std::uses_allocator_v<T,
+                                            typename Container::allocator_type>)
+        {
+            return T(container.get_allocator());
+        }
+        else
+        {
+            return T();
+        }
     }
-
-    for (auto pos_opt : split_opts.positional)
+    else
     {
-        os << " " << pos_opt->get_help().first;
+        return T();
     }
-    os << "\nOptions:\n";
+}
 
-    for (OptionBase *opt : opts)
-    {
-        std::pair<std::string, std::string> &&help = opt->get_help();
+template <class T>
+inline bool is_exact_type(const OptionBase &option)
+{
+    return typeid(option) == typeid(T);
+}
 
-        if (help.first.length() <= min_w - 2)
+template <class T>
+inline T copy_with_allocator(const T &val)
+{
+    if constexpr (has_allocator_type<T>::value)
+    {
+        using allocator_type = typename T::allocator_type;
+        if constexpr (std::is_constructible_v<T, const T &,
+                                              const allocator_type &>)
         {
-            os << std::setw(min_w - 2) << help.first << "  ";
+            return T(val, val.get_allocator());
         }
         else
         {
-            os << help.first << "\n" << std::setw(min_w) << "";
+            return val;
         }
-        os << impl::indented(help.second, min_w) << "\n";
     }
-    os.flags(flags);
+    else
+    {
+        return val;
+    }
+}
+
+template <class T, bool IsCopyable>
+inline default_value<T, IsCopyable>::default_value(const T &val)
+    : val(copy_with_allocator(val))
+{
+}
+
+template <class T, bool IsCopyable>
+inline void default_value<T, IsCopyable>::restore(T &dst) const
+{
+    dst = this->val;
+}
+
+template <class T>
+inline default_value<T, false>::default_value(const T &)
+{
+}
+
+template <class T>
+inline void default_value<T, false>::restore(T &dst) const
+{
+    dst = T();
+}
+
+} // namespace impl
+
+template <class T>
+inline void PositionalOption<T>::assign_args(arg_span args)
+{
+    impl::convert(args[0], this->val);
+}
+
+template <class T>
+inline void PositionalOption<T>::from_string(
+    const std::vector<std::string_view> &strings)
+{
+    this->assign_args(arg_span(strings));
+}
+
+template <class T>
+inline void PositionalOption<T>::from_args(arg_span args)
+{
+    if (impl::is_exact_type<PositionalOption<T>>(*this))
+    {
+        this->assign_args(args);
+    }
+    else
+    {
+        OptionBase::from_args(args);
+    }
+}
+
+template <class T>
+inline PositionalOption<T>::PositionalOption(std::string name, std::string help,
+                                             bool is_required,
+                                             T val /* = T() */)
+    : PositionalOptionBase(std::move(name), std::move(help), is_required),
+      val(std::move(val)),
+      default_val(this->val)
+{
+}
+
+template <class T>
+inline void PositionalOption<T>::reset()
+{
+    OptionBase::reset();
+    this->default_val.restore(this->val);
+}
+
+template <class T>
+inline int PositionalOption<T>::get_param_count()
+{
+    return 0;
+}
+
+template <class T>
+inline bool PositionalOption<T>::matches(std::string_view)
+{
+    return !this->is_set();
+}
+
+template <class T>
+inline PositionalOptionBase::Arity PositionalOption<T>::get_arity() const
+{
+    return impl::is_exact_type<PositionalOption<T>>(*this) ? SINGLE : CUSTOM;
+}
+
+template <class T>
+inline T PositionalOption<T>::get_val() const
+{
+    return this->val;
+}
+
+template <class T>
+inline const T &PositionalOption<T>::value() const
+{
+    return this->val;
+}
+
+template <class T>
+inline T &&PositionalOption<T>::take() &&
+{
+    return std::move(this->val);
+}
+
+template <class T>
+inline constexpr const int KeywordOption<T>::NUM_OPTS = 1;
+
+template <>
+inline constexpr const int KeywordOption<bool>::NUM_OPTS = 0;
+
+template <class T>
+inline void KeywordOption<T>::assign_args(arg_span args)
+{
+    impl::convert(args[1], this->val);
+}
+
+template <>
+inline void KeywordOption<bool>::assign_args(arg_span)
+{
+    this->val = true;
+}
+
+template <class T>
+inline void KeywordOption<T>::from_string(
+    const std::vector<std::string_view> &strings)
+{
+    this->assign_args(arg_span(strings));
+}
+
+template <class T>
+inline void KeywordOption<T>::from_args(arg_span args)
+{
+    if (impl::is_exact_type<KeywordOption<T>>(*this))
+    {
+        this->assign_args(args);
+    }
+    else
+    {
+        OptionBase::from_args(args);
+    }
+}
+
+template <class T>
+inline KeywordOption<T>::KeywordOption(std::vector<std::string> identifiers,
+                                       std::string help, T val /* = T() */)
+    : KeywordOptionBase(std::move(identifiers), std::move(help)),
+      val(std::move(val)),
+      default_val(this->val)
+{
+}
+
+template <class T>
+inline void KeywordOption<T>::reset()
+{
+    OptionBase::reset();
+    this->default_val.restore(this->val);
+}
+
+template <class T>
+inline int KeywordOption<T>::get_param_count()
+{
+    return NUM_OPTS;
+}
+
+template <class T>
+inline bool KeywordOption<T>::matches(std::string_view identifier)
+{
+    return this->has_identifier(identifier);
+}
+
+template <class T>
+inline bool KeywordOption<T>::has_exact_identifiers() const
+{
+    return impl::is_exact_type<KeywordOption<T>>(*this);
+}
+
+template <typename T>
+inline T KeywordOption<T>::get_val() const
+{
+    return val;
+}
+
+template <class T>
+inline const T &KeywordOption<T>::value() const
+{
+    return this->val;
+}
+
+template <class T>
+inline T &&KeywordOption<T>::take() &&
+{
+    return std::move(this->val);
+}
+
+template <class T, class Container>
+inline void MultiKeywordOption<T, Container>::assign_args(arg_span args)
+{
+    T tmp = impl::make_element<T>(this->val);
+    impl::convert(args[1], tmp);
+    this->val.insert(this->val.end(), std::move(tmp));
+}
+
+template <class T, class Container>
+inline void MultiKeywordOption<T, Container>::from_string(
+    const std::vector<std::string_view> &strings)
+{
+    this->assign_args(arg_span(strings));
+}
+
+template <class T, class Container>
+inline void MultiKeywordOption<T, Container>::from_args(arg_span args)
+{
+    if (impl::is_exact_type<MultiKeywordOption<T, Container>>(*this))
+    {
+        this->assign_args(args);
+    }
+    else
+    {
+        OptionBase::from_args(args);
+    }
+}
+
+template <class T, class Container>
+inline void MultiKeywordOption<T, Container>::parse_batch(
+    const arg_span *occurrences, size_t count, size_t threads, size_t &failed)
+{
+    if (!impl::is_exact_type<MultiKeywordOption<T, Container>>(*this))
+    {
+        // a subclass may override from_string
+        OptionBase::parse_batch(occurrences, count, threads, failed);
+        return;
+    }
+
+    std::vector<T> values;
+    values.reserve(count);
+    for (size_t k = 0; k < count; k++)
+    {
+        values.push_back(impl::make_element<T>(this->val));
+    }
+
+    size_t chunks     = std::max<size_t>(1, std::min(threads, count));
+    size_t chunk_size = (count + chunks - 1) / chunks;
+    std::vector<size_t> chunk_failed(chunks, count);
+    std::vector<std::exception_ptr> errors(chunks);
+
+    impl::run_parallel(chunks, threads,
+                       [&](size_t c)
+                       {
+                           size_t end = std::min(count, (c + 1) * chunk_size);
+                           for (size_t k = c * chunk_size; k < end; k++)
+                           {
+                               try
+                               {
+                                   impl::convert(occurrences[k][1], values[k]);
+                               }
+                               catch (...)
+                               {
+                                   chunk_failed[c] = k;
+                                   errors[c]       = std::current_exception();
+                                   return;
+                               }
+                           }
+                       });
+
+    // chunks are in order, so the first failed chunk has the first failure
+    size_t first_failed = count;
+    std::exception_ptr error;
+    for (size_t c = 0; c < chunks; c++)
+    {
+        if (chunk_failed[c] != count)
+        {
+            first_failed = chunk_failed[c];
+            error        = errors[c];
+            break;
+        }
+    }
+
+    if (first_failed > 0)
+    {
+        this->reserve(this->val.size() + first_failed);
+        for (size_t k = 0; k < first_failed; k++)
+        {
+            this->val.insert(this->val.end(), std::move(values[k]));
+        }
+        this->is_set_ = true;
+    }
+
+    if (error)
+    {
+        failed = first_failed;
+        std::rethrow_exception(error);
+    }
+}
+
+template <class T, class Container>
+inline MultiKeywordOption<T, Container>::MultiKeywordOption(
+    std::vector<std::string> identifiers, std::string help,
+    Container val /* = Container() */)
+    : KeywordOptionBase(std::move(identifiers), std::move(help)),
+      val(std::move(val)),
+      default_val(this->val)
+{
+}
+
+template <class T, class Container>
+inline void MultiKeywordOption<T, Container>::reset()
+{
+    OptionBase::reset();
+    this->default_val.restore(this->val);
+}
+
+template <class T, class Container>
+inline int MultiKeywordOption<T, Container>::get_param_count()
+{
+    return 1;
+}
+
+template <class T, class Container>
+inline bool MultiKeywordOption<T, Container>::matches(
+    std::string_view identifier)
+{
+    return this->has_identifier(identifier);
+}
+
+template <class T, class Container>
+inline bool MultiKeywordOption<T, Container>::has_exact_identifiers() const
+{
+    return impl::is_exact_type<MultiKeywordOption<T, Container>>(*this);
+}
+
+template <class T, class Container>
+inline void MultiKeywordOption<T, Container>::reserve(size_t count)
+{
+    if constexpr (impl::has_reserve<Container>::value)
+    {
+        this->val.reserve(count);
+    }
+}
+
+template <class T, class Container>
+inline Container MultiKeywordOption<T, Container>::get_val() const
+{
+    return this->val;
+}
+
+template <class T, class Container>
+inline const Container &MultiKeywordOption<T, Container>::value() const
+{
+    return this->val;
+}
+
+template <class T, class Container>
+inline Container &&MultiKeywordOption<T, Container>::take() &&
+{
+    return std::move(this->val);
+}
+
+template <class T, class Container>
+inline void PositionalListOption<T, Container>::assign_args(arg_span args)
+{
+    if constexpr (impl::has_reserve<Container>::value)
+    {
+        // reserving on every run would defeat the geometric growth
+        if (this->val.empty())
+        {
+            this->val.reserve(args.size());
+        }
+    }
+
+    for (std::string_view arg : args)
+    {
+        T tmp = impl::make_element<T>(this->val);
+        impl::convert(arg, tmp);
+        this->val.insert(this->val.end(), std::move(tmp));
+    }
+}
+
+template <class T, class Container>
+inline void PositionalListOption<T, Container>::from_string(
+    const std::vector<std::string_view> &strings)
+{
+    this->assign_args(arg_span(strings));
+}
+
+template <class T, class Container>
+inline void PositionalListOption<T, Container>::from_args(arg_span args)
+{
+    if (impl::is_exact_type<PositionalListOption<T, Container>>(*this))
+    {
+        this->assign_args(args);
+    }
+    else
+    {
+        OptionBase::from_args(args);
+    }
+}
+
+template <class T, class Container>
+inline PositionalListOption<T, Container>::PositionalListOption(
+    std::string name, std::string help, bool is_required,
+    Container val /* = Container() */)
+    : PositionalOptionBase(std::move(name), std::move(help), is_required),
+      val(std::move(val)),
+      default_val(this->val)
+{
+}
+
+template <class T, class Container>
+inline void PositionalListOption<T, Container>::reset()
+{
+    OptionBase::reset();
+    this->default_val.restore(this->val);
+}
+
+template <class T, class Container>
+inline int PositionalListOption<T, Container>::get_param_count()
+{
+    return 0;
+}
+
+template <class T, class Container>
+inline bool PositionalListOption<T, Container>::matches(std::string_view)
+{
+    return true;
+}
+
+template <class T, class Container>
+inline PositionalOptionBase::Arity
+PositionalListOption<T, Container>::get_arity() const
+{
+    return impl::is_exact_type<PositionalListOption<T, Container>>(*this)
+               ? LIST
+               : CUSTOM;
+}
+
+template <class T, class Container>
+inline std::pair<std::string, std::string>
+PositionalListOption<T, Container>::get_help() const
+{
+    return {(this->is_required) ? this->name + "..."
+                                : "[" + this->name + "...]",
+            this->help};
+}
+
+template <class T, class Container>
+inline Container PositionalListOption<T, Container>::get_val() const
+{
+    return this->val;
+}
+
+template <class T, class Container>
+inline const Container &PositionalListOption<T, Container>::value() const
+{
+    return this->val;
+}
+
+template <class T, class Container>
+inline Container &&PositionalListOption<T, Container>::take() &&
+{
+    return std::move(this->val);
+}
+
+namespace impl
+{
+
+template <class T>
+inline lazy_value<T>::lazy_value(T val)
+    : val(std::move(val)), converted(true), raw()
+{
+}
+
+template <class T>
+inline void lazy_value<T>::set_raw(std::string_view raw)
+{
+    this->raw.assign(raw.data(), raw.size());
+    this->converted = false;
+}
+
+template <class T>
+inline void lazy_value<T>::set(T val)
+{
+    this->val       = std::move(val);
+    this->converted = true;
+}
+
+template <class T>
+inline void lazy_value<T>::reset(const default_value<T> &val)
+{
+    val.restore(this->val);
+    this->converted = true;
+}
+
+template <class T>
+inline const T &lazy_value<T>::get() const
+{
+    if (!this->converted)
+    {
+        impl::convert(this->raw, this->val);
+        this->converted = true;
+    }
+
+    return this->val;
+}
+
+template <class T>
+inline T &&lazy_value<T>::take()
+{
+    this->get();
+    return std::move(this->val);
+}
+
+} // namespace impl
+
+template <class T>
+inline void LazyPositionalOption<T>::assign_args(arg_span args)
+{
+    this->val.set_raw(args[0]);
+}
+
+template <class T>
+inline void LazyPositionalOption<T>::from_string(
+    const std::vector<std::string_view> &strings)
+{
+    this->assign_args(arg_span(strings));
+}
+
+template <class T>
+inline void LazyPositionalOption<T>::from_args(arg_span args)
+{
+    if (impl::is_exact_type<LazyPositionalOption<T>>(*this))
+    {
+        this->assign_args(args);
+    }
+    else
+    {
+        OptionBase::from_args(args);
+    }
+}
+
+template <class T>
+inline LazyPositionalOption<T>::LazyPositionalOption(std::string name,
+                                                     std::string help,
+                                                     bool is_required,
+                                                     T val /* = T() */)
+    : PositionalOptionBase(std::move(name), std::move(help), is_required),
+      val(std::move(val)),
+      default_val(this->val.get())
+{
+}
+
+template <class T>
+inline void LazyPositionalOption<T>::reset()
+{
+    OptionBase::reset();
+    this->val.reset(this->default_val);
+}
+
+template <class T>
+inline int LazyPositionalOption<T>::get_param_count()
+{
+    return 0;
+}
+
+template <class T>
+inline bool LazyPositionalOption<T>::matches(std::string_view)
+{
+    return !this->is_set();
+}
+
+template <class T>
+inline PositionalOptionBase::Arity LazyPositionalOption<T>::get_arity() const
+{
+    return impl::is_exact_type<LazyPositionalOption<T>>(*this) ? SINGLE
+                                                                : CUSTOM;
+}
+
+template <class T>
+inline void LazyPositionalOption<T>::validate() const
+{
+    this->val.get();
+}
+
+template <class T>
+inline T LazyPositionalOption<T>::get_val() const
+{
+    return this->val.get();
+}
+
+template <class T>
+inline const T &LazyPositionalOption<T>::value() const
+{
+    return this->val.get();
+}
+
+template <class T>
+inline T &&LazyPositionalOption<T>::take() &&
+{
+    return this->val.take();
+}
+
+template <class T>
+inline void LazyKeywordOption<T>::assign_args(arg_span args)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        this->val.set(true);
+    }
+    else
+    {
+        this->val.set_raw(args[1]);
+    }
+}
+
+template <class T>
+inline void LazyKeywordOption<T>::from_string(
+    const std::vector<std::string_view> &strings)
+{
+    this->assign_args(arg_span(strings));
+}
+
+template <class T>
+inline void LazyKeywordOption<T>::from_args(arg_span args)
+{
+    if (impl::is_exact_type<LazyKeywordOption<T>>(*this))
+    {
+        this->assign_args(args);
+    }
+    else
+    {
+        OptionBase::from_args(args);
+    }
+}
+
+template <class T>
+inline LazyKeywordOption<T>::LazyKeywordOption(
+    std::vector<std::string> identifiers, std::string help, T val /* = T() */)
+    : KeywordOptionBase(std::move(identifiers), std::move(help)),
+      val(std::move(val)),
+      default_val(this->val.get())
+{
+}
+
+template <class T>
+inline void LazyKeywordOption<T>::reset()
+{
+    OptionBase::reset();
+    this->val.reset(this->default_val);
+}
+
+template <class T>
+inline int LazyKeywordOption<T>::get_param_count()
+{
+    return std::is_same_v<T, bool> ? 0 : 1;
+}
+
+template <class T>
+inline bool LazyKeywordOption<T>::matches(std::string_view identifier)
+{
+    return this->has_identifier(identifier);
+}
+
+template <class T>
+inline bool LazyKeywordOption<T>::has_exact_identifiers() const
+{
+    return impl::is_exact_type<LazyKeywordOption<T>>(*this);
+}
+
+template <class T>
+inline void LazyKeywordOption<T>::validate() const
+{
+    this->val.get();
+}
+
+template <class T>
+inline T LazyKeywordOption<T>::get_val() const
+{
+    return this->val.get();
+}
+
+template <class T>
+inline const T &LazyKeywordOption<T>::value() const
+{
+    return this->val.get();
+}
+
+template <class T>
+inline T &&LazyKeywordOption<T>::take() &&
+{
+    return this->val.take();
+}
+
+template <class T, class Fn>
+inline void CallbackOption<T, Fn>::assign_args(arg_span args)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        this->buffer = true;
+    }
+    else
+    {
+        impl::convert(args[1], this->buffer);
+    }
+    this->fn(this->buffer);
+}
+
+template <class T, class Fn>
+inline void CallbackOption<T, Fn>::from_string(
+    const std::vector<std::string_view> &strings)
+{
+    this->assign_args(arg_span(strings));
+}
+
+template <class T, class Fn>
+inline void CallbackOption<T, Fn>::from_args(arg_span args)
+{
+    if (impl::is_exact_type<CallbackOption<T, Fn>>(*this))
+    {
+        this->assign_args(args);
+    }
+    else
+    {
+        OptionBase::from_args(args);
+    }
+}
+
+template <class T, class Fn>
+inline CallbackOption<T, Fn>::CallbackOption(
+    std::vector<std::string> identifiers, std::string help, Fn fn)
+    : KeywordOptionBase(std::move(identifiers), std::move(help)),
+      fn(std::move(fn)),
+      buffer()
+{
+}
+
+template <class T, class Fn>
+inline int CallbackOption<T, Fn>::get_param_count()
+{
+    return std::is_same_v<T, bool> ? 0 : 1;
+}
+
+template <class T, class Fn>
+inline bool CallbackOption<T, Fn>::matches(std::string_view identifier)
+{
+    return this->has_identifier(identifier);
+}
+
+template <class T, class Fn>
+inline bool CallbackOption<T, Fn>::has_exact_identifiers() const
+{
+    return impl::is_exact_type<CallbackOption<T, Fn>>(*this);
+}
+
+template <class T, class Fn>
+inline bool CallbackOption<T, Fn>::converts_in_parallel() const
+{
+    return false;
+}
+
+template <class T, class Fn>
+inline CallbackOption<T, std::decay_t<Fn>> callback_option(
+    std::vector<std::string> identifiers, std::string help, Fn &&fn)
+{
+    return CallbackOption<T, std::decay_t<Fn>>(
+        std::move(identifiers), std::move(help), std::forward<Fn>(fn));
+}
+
+namespace impl
+{
+
+inline option_set::option_set(size_t count /* = 0 */)
+    : words((count + 63) / 64, 0)
+{
+}
+
+inline void option_set::assign(size_t count)
+{
+    this->words.assign((count + 63) / 64, 0);
+}
+
+inline void option_set::insert(size_t id)
+{
+    this->words[id / 64] |= uint64_t(1) << (id % 64);
+}
+
+inline bool option_set::contains(size_t id) const
+{
+    return (this->words[id / 64] >> (id % 64)) & 1;
+}
+
+inline bool option_set::empty() const
+{
+    for (uint64_t word : this->words)
+    {
+        if (word != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline size_t option_set::first_missing(const option_set &other) const
+{
+    for (size_t w = 0; w < other.words.size(); w++)
+    {
+        uint64_t missing = other.words[w] & ~this->words[w];
+        if (missing != 0)
+        {
+            size_t bit = 0;
+            while (!((missing >> bit) & 1))
+            {
+                bit++;
+            }
+            return w * 64 + bit;
+        }
+    }
+
+    return static_cast<size_t>(-1);
+}
+
+inline bool option_set::has_several_common(const option_set &other) const
+{
+    bool found = false;
+    for (size_t w = 0; w < other.words.size(); w++)
+    {
+        uint64_t common = other.words[w] & this->words[w];
+        if (common == 0)
+        {
+            continue;
+        }
+        // clearing the lowest bit leaves any other
+        if (found || (common & (common - 1)) != 0)
+        {
+            return true;
+        }
+        found = true;
+    }
+
+    return false;
+}
+
+inline uint64_t identifier_table::hash(std::string_view identifier)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (char c : identifier)
+    {
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return h;
+}
+
+inline void identifier_table::rehash(size_t bucket_count)
+{
+    this->buckets.assign(bucket_count, 0);
+    for (size_t e = 0; e < this->hashes.size(); e++)
+    {
+        this->place(e);
+    }
+}
+
+inline void identifier_table::place(size_t entry)
+{
+    size_t mask = this->buckets.size() - 1;
+    size_t b    = this->hashes[entry] & mask;
+    while (this->buckets[b] != 0)
+    {
+        b = (b + 1) & mask;
+    }
+    this->buckets[b] = static_cast<uint32_t>(entry + 1);
+}
+
+inline bool identifier_table::insert(std::string_view identifier, size_t id,
+                                     int param_count)
+{
+    uint64_t h = identifier_table::hash(identifier);
+    if (this->find(identifier, h) != NO_ENTRY)
+    {
+        return false;
+    }
+
+    this->offsets.push_back(static_cast<uint32_t>(this->pool.size()));
+    this->lengths.push_back(static_cast<uint32_t>(identifier.size()));
+    this->hashes.push_back(h);
+    this->ids.push_back(id);
+    this->param_counts.push_back(param_count);
+    this->pool.append(identifier);
+
+    // keep the load factor at most 1/2, so probe sequences stay short
+    if (this->hashes.size() * 2 > this->buckets.size())
+    {
+        this->rehash(std::max<size_t>(16, this->buckets.size() * 2));
+    }
+    else
+    {
+        this->place(this->hashes.size() - 1);
+    }
+
+    return true;
+}
+
+inline size_t identifier_table::find(std::string_view identifier) const
+{
+    return this->find(identifier, identifier_table::hash(identifier));
+}
+
+inline size_t identifier_table::find(std::string_view identifier,
+                                     uint64_t h) const
+{
+    if (this->buckets.empty())
+    {
+        return NO_ENTRY;
+    }
+
+    size_t mask = this->buckets.size() - 1;
+    for (size_t b = h & mask; this->buckets[b] != 0; b = (b + 1) & mask)
+    {
+        size_t e = this->buckets[b] - 1;
+        if (this->hashes[e] == h && this->lengths[e] == identifier.size() &&
+            this->identifier(e) == identifier)
+        {
+            return e;
+        }
+    }
+
+    return NO_ENTRY;
+}
+
+inline size_t identifier_table::size() const { return this->ids.size(); }
+
+inline std::string_view identifier_table::identifier(size_t entry) const
+{
+    return std::string_view(this->pool).substr(this->offsets[entry],
+                                               this->lengths[entry]);
+}
+
+inline size_t identifier_table::id(size_t entry) const
+{
+    return this->ids[entry];
+}
+
+inline int identifier_table::param_count(size_t entry) const
+{
+    return this->param_counts[entry];
+}
+
+inline OptionBase *match_option(const char *arg, const OptionsList &opts)
+{
+    return match_option(arg, split_options(opts));
+}
+
+inline OptionBase *match_option(const char *arg,
+                                const split_options &split_opts)
+{
+    for (auto opt : split_opts.keyword)
+    {
+        if (opt->matches(arg))
+        {
+            return opt;
+        }
+    }
+
+    for (auto opt : split_opts.positional)
+    {
+        if (opt->matches(arg))
+        {
+            return opt;
+        }
+    }
+
+    return nullptr;
+}
+
+inline void handle_match(int &i, OptionBase *opt, int argc, const char *argv[])
+{
+    int param_count = opt->get_param_count();
+    if (param_count < -1)
+    {
+        throw std::invalid_argument("Invalid number of requested parameters.");
+    }
+
+    if (param_count == -1)
+    {
+        param_count = argc - i - 1;
+    }
+
+    if (i + param_count >= argc)
+    {
+        throw std::out_of_range("Not enough arguments.");
+    }
+
+    std::vector<std::string_view> opts;
+    opts.reserve(param_count + 1);
+
+    for (int end = i + param_count + 1; i < end; i++)
+    {
+        opts.push_back(std::string_view(argv[i]));
+    }
+    --i;
+
+    opt->parse(opts);
+}
+
+inline size_t param_span(size_t i, OptionBase *opt, arg_span args)
+{
+    int param_count = opt->get_param_count();
+    if (param_count < -1)
+    {
+        throw std::invalid_argument("Invalid number of requested parameters.");
+    }
+
+    size_t count = (param_count == -1) ? args.size() - i - 1
+                                       : static_cast<size_t>(param_count);
+
+    if (i + count >= args.size())
+    {
+        throw std::out_of_range("Not enough arguments.");
+    }
+
+    return count;
+}
+
+inline void handle_match(size_t &i, OptionBase *opt, arg_span args)
+{
+    size_t count = param_span(i, opt, args);
+
+    opt->parse(args.subspan(i, count + 1));
+    i += count;
+}
+
+template <class Fn>
+inline void run_parallel(size_t count, size_t threads, Fn &&fn)
+{
+    threads = std::min(threads, count);
+    if (threads <= 1)
+    {
+        for (size_t k = 0; k < count; k++)
+        {
+            fn(k);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]
+    {
+        for (size_t k = next++; k < count; k = next++)
+        {
+            fn(k);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (size_t t = 1; t < threads; t++)
+    {
+        try
+        {
+            pool.emplace_back(worker);
+        }
+        catch (const std::system_error &)
+        {
+            // continue with the threads that could be started
+            break;
+        }
+    }
+
+    worker();
+    for (auto &thread : pool)
+    {
+        thread.join();
+    }
+}
+
+#ifdef ARGP_HAS_MMAP
+
+inline mapped_file::mapped_file(const std::string &path)
+    : addr(nullptr), length(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        throw std::invalid_argument("Could not read response file: " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1)
+    {
+        ::close(fd);
+        throw std::invalid_argument("Could not read response file: " + path);
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        this->length = static_cast<size_t>(st.st_size);
+        void *mem    = ::mmap(nullptr, this->length, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE, fd, 0);
+        if (mem == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::invalid_argument("Could not read response file: " +
+                                        path);
+        }
+        this->addr = static_cast<char *>(mem);
+        ::close(fd);
+        return;
+    }
+
+    // size of pipes and devices is not known, read until the end instead
+    size_t capacity = 0;
+    while (true)
+    {
+        if (this->length == capacity)
+        {
+            this->grow_buffer(capacity);
+        }
+
+        ssize_t count = ::read(fd, this->buffer.get() + this->length,
+                               capacity - this->length);
+        if (count == 0)
+        {
+            break;
+        }
+        if (count == -1 && errno != EINTR)
+        {
+            ::close(fd);
+            throw std::invalid_argument("Could not read response file: " +
+                                        path);
+        }
+        this->length += (count > 0) ? static_cast<size_t>(count) : 0;
+    }
+    this->addr = this->buffer.get();
+    ::close(fd);
+}
+
+inline mapped_file::~mapped_file()
+{
+    if (this->addr != nullptr && this->buffer == nullptr)
+    {
+        ::munmap(this->addr, this->length);
+    }
+}
+
+#else
+
+inline mapped_file::mapped_file(const std::string &path)
+    : addr(nullptr), length(0)
+{
+    std::ifstream ifs(path, std::ios_base::binary);
+    if (!ifs)
+    {
+        throw std::invalid_argument("Could not read response file: " + path);
+    }
+
+    // tellg is -1 for pipes and devices, which can't seek
+    std::streamoff end = ifs.seekg(0, std::ios_base::end).tellg();
+    if (end > 0)
+    {
+        this->length = static_cast<size_t>(end);
+        this->buffer = std::make_unique<char[]>(this->length);
+        this->addr   = this->buffer.get();
+
+        ifs.seekg(0);
+        if (!ifs.read(this->addr, this->length))
+        {
+            throw std::invalid_argument("Could not read response file: " +
+                                        path);
+        }
+        return;
+    }
+
+    // size of pipes and devices is not known, read until the end instead
+    ifs.clear();
+    ifs.seekg(0);
+    ifs.clear();
+    size_t capacity = 0;
+    while (ifs)
+    {
+        if (this->length == capacity)
+        {
+            this->grow_buffer(capacity);
+        }
+        ifs.read(this->buffer.get() + this->length, capacity - this->length);
+        this->length += static_cast<size_t>(ifs.gcount());
+    }
+    if (ifs.bad())
+    {
+        throw std::invalid_argument("Could not read response file: " + path);
+    }
+    this->addr = this->buffer.get();
+}
+
+inline mapped_file::~mapped_file() {}
+
+#endif
+
+inline mapped_file::mapped_file(mapped_file &&other) noexcept
+    : addr(other.addr), length(other.length), buffer(std::move(other.buffer))
+{
+    other.addr   = nullptr;
+    other.length = 0;
+}
+
+inline void mapped_file::grow_buffer(size_t &capacity)
+{
+    capacity = std::max<size_t>(capacity * 2, 4096);
+    auto grown = std::make_unique<char[]>(capacity);
+    if (this->length > 0)
+    {
+        std::memcpy(grown.get(), this->buffer.get(), this->length);
+    }
+    this->buffer = std::move(grown);
+}
+
+inline char *mapped_file::data() const { return this->addr; }
+
+inline size_t mapped_file::size() const { return this->length; }
+
+inline bool is_special(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+           c == '\v' || c == '"' || c == '\'' || c == '\\';
+}
+
+inline unsigned lowest_bit(uint64_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+inline size_t find_special(const char *data, size_t size)
+{
+    size_t i = 0;
+
+#if defined(ARGP_SIMD_AVX2)
+    const __m256i space     = _mm256_set1_epi8(' ');
+    const __m256i dquote    = _mm256_set1_epi8('"');
+    const __m256i squote    = _mm256_set1_epi8('\'');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i ctrl_low  = _mm256_set1_epi8('\t');
+    const __m256i ctrl_span = _mm256_set1_epi8('\r' - '\t');
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + i));
+        // '\t' to '\r' are consecutive, (v - '\t') <= 4 as unsigned
+        __m256i ctrl = _mm256_sub_epi8(v, ctrl_low);
+        __m256i m    = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                            _mm256_cmpeq_epi8(v, dquote)),
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, squote),
+                                _mm256_cmpeq_epi8(v, backslash)),
+                _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, ctrl_span), ctrl)));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(m));
+        if (mask != 0)
+        {
+            return i + lowest_bit(mask);
+        }
+    }
+#elif defined(ARGP_SIMD_SSE2)
+    const __m128i space     = _mm_set1_epi8(' ');
+    const __m128i dquote    = _mm_set1_epi8('"');
+    const __m128i squote    = _mm_set1_epi8('\'');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i ctrl_low  = _mm_set1_epi8('\t');
+    const __m128i ctrl_span = _mm_set1_epi8('\r' - '\t');
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        // '\t' to '\r' are consecutive, (v - '\t') <= 4 as unsigned
+        __m128i ctrl = _mm_sub_epi8(v, ctrl_low);
+        __m128i m    = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, dquote)),
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, squote),
+                             _mm_cmpeq_epi8(v, backslash)),
+                _mm_cmpeq_epi8(_mm_min_epu8(ctrl, ctrl_span), ctrl)));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(m));
+        if (mask != 0)
+        {
+            return i + lowest_bit(mask);
+        }
+    }
+#elif defined(ARGP_SIMD_NEON)
+    const uint8x16_t space     = vdupq_n_u8(' ');
+    const uint8x16_t dquote    = vdupq_n_u8('"');
+    const uint8x16_t squote    = vdupq_n_u8('\'');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t ctrl_low  = vdupq_n_u8('\t');
+    const uint8x16_t ctrl_span = vdupq_n_u8('\r' - '\t');
+    for (; i + 16 <= size; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(data + i));
+        // '\t' to '\r' are consecutive, (v - '\t') <= 4 as unsigned
+        uint8x16_t ctrl = vsubq_u8(v, ctrl_low);
+        uint8x16_t m    = vorrq_u8(
+            vorrq_u8(vceqq_u8(v, space), vceqq_u8(v, dquote)),
+            vorrq_u8(vorrq_u8(vceqq_u8(v, squote), vceqq_u8(v, backslash)),
+                     vcleq_u8(ctrl, ctrl_span)));
+        // narrow every byte of the mask to 4 bits
+        uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+        if (mask != 0)
+        {
+            return i + lowest_bit(mask) / 4;
+        }
+    }
+#endif
+
+    for (; i < size; i++)
+    {
+        if (is_special(data[i]))
+        {
+            return i;
+        }
+    }
+
+    return size;
+}
+
+inline void tokenize_response_file(char *data, size_t size,
+                                   std::pmr::vector<std::string_view> &args)
+{
+    auto is_space = [](char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+               c == '\v';
+    };
+
+    size_t i = 0;
+    while (true)
+    {
+        while (i < size && is_space(data[i]))
+        {
+            i++;
+        }
+        if (i == size)
+        {
+            break;
+        }
+
+        char *start = data + i;
+        char *out   = start;
+
+        // only write when the output fell behind the input, untouched pages
+        // of the mapping are then never copied
+        auto put = [&](size_t pos)
+        {
+            if (out != data + pos)
+            {
+                *out = data[pos];
+            }
+            out++;
+        };
+
+        while (i < size)
+        {
+            // move the run of plain characters at once
+            size_t run = find_special(data + i, size - i);
+            if (run > 0)
+            {
+                if (out != data + i)
+                {
+                    std::memmove(out, data + i, run);
+                }
+                out += run;
+                i += run;
+                continue;
+            }
+
+            char c = data[i];
+            if (is_space(c))
+            {
+                break;
+            }
+            if (c == '"' || c == '\'')
+            {
+                i++;
+                while (i < size && data[i] != c)
+                {
+                    if (c == '"' && data[i] == '\\' && i + 1 < size)
+                    {
+                        i++;
+                    }
+                    put(i++);
+                }
+                if (i == size)
+                {
+                    throw std::invalid_argument(
+                        "Unterminated quote in response file.");
+                }
+                i++;
+            }
+            else if (c == '\\' && i + 1 < size)
+            {
+                i++;
+                put(i++);
+            }
+            else
+            {
+                put(i++);
+            }
+        }
+
+        args.emplace_back(start, static_cast<size_t>(out - start));
+    }
+}
+
+template <class Fn>
+inline void parse_config(std::string_view data, Fn &&entry)
+{
+    auto trim = [](std::string_view str)
+    {
+        size_t first = str.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos)
+        {
+            return std::string_view();
+        }
+        size_t last = str.find_last_not_of(" \t\r");
+        return str.substr(first, last + 1 - first);
+    };
+
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        size_t end = std::min(data.find('\n', pos), data.size());
+        std::string_view line = trim(data.substr(pos, end - pos));
+        pos                   = end + 1;
+
+        if (line.empty() || line[0] == '#' || line[0] == ';')
+        {
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == std::string_view::npos)
+        {
+            entry(line, std::string_view(), false);
+            continue;
+        }
+
+        std::string_view value = trim(line.substr(eq + 1));
+        if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'') &&
+            value.back() == value[0])
+        {
+            value = value.substr(1, value.size() - 2);
+        }
+        entry(trim(line.substr(0, eq)), value, true);
+    }
+}
+
+inline void append_help_line(std::string &out, std::string_view first,
+                             std::string_view second, size_t min_w,
+                             size_t width, char fill /* = ' ' */)
+{
+    out += first;
+    if (first.length() + 2 <= min_w)
+    {
+        out.append(min_w - 2 - first.length(), fill);
+        out += "  ";
+    }
+    else
+    {
+        out += '\n';
+        out.append(min_w, fill);
+    }
+
+    size_t text_w = (width > min_w) ? width - min_w : 0;
+    size_t pos    = 0;
+    while (pos < second.size())
+    {
+        size_t end = std::min(second.find_first_of("\n\r", pos), second.size());
+        std::string_view line = second.substr(pos, end - pos);
+        if (text_w == 0)
+        {
+            out += line;
+        }
+        else
+        {
+            append_wrapped(out, line, min_w, text_w);
+        }
+
+        if (end < second.size())
+        {
+            out += second[end];
+            out.append(min_w, ' ');
+        }
+        pos = end + 1;
+    }
+    out += '\n';
+}
+
+inline void append_wrapped(std::string &out, std::string_view line,
+                           size_t indent, size_t text_w)
+{
+    size_t column = 0;
+    size_t pos    = 0;
+    while (pos < line.size())
+    {
+        size_t end = std::min(line.find(' ', pos), line.size());
+        std::string_view word = line.substr(pos, end - pos);
+
+        if (column > 0 && column + 1 + word.size() > text_w)
+        {
+            out += '\n';
+            out.append(indent, ' ');
+            column = 0;
+        }
+        else if (column > 0)
+        {
+            out += ' ';
+            column++;
+        }
+        out += word;
+        column += word.size();
+        pos = end + 1;
+    }
+}
+
+inline void append_shell_quoted(std::string &out, std::string_view str)
+{
+    out += '\'';
+    for (char c : str)
+    {
+        if (c == '\'')
+        {
+            // close the quotes, add escaped quote and open them again
+            out += "'\\''";
+            continue;
+        }
+        out += (c == '\n' || c == '\r') ? ' ' : c;
+    }
+    out += '\'';
+}
+
+inline indented::indented(std::string_view str, size_t width,
+                          char fill /* = ' ' */)
+    : str(str), width(width), fill(fill)
+{
+}
+
+inline std::ostream &operator<<(std::ostream &os, const indented &val)
+{
+    size_t pos = 0;
+    while (pos < val.str.size())
+    {
+        size_t end = val.str.find_first_of("\n\r", pos);
+        if (end == std::string_view::npos)
+        {
+            os.write(val.str.data() + pos, val.str.size() - pos);
+            break;
+        }
+
+        os.write(val.str.data() + pos, end + 1 - pos);
+        for (size_t i = 0; i < val.width; i++)
+        {
+            os.put(val.fill);
+        }
+        pos = end + 1;
+    }
+
+    return os;
+}
+
+} // namespace impl
+
+inline AmbiguousOptionError::AmbiguousOptionError(
+    std::string_view arg, std::vector<std::string> candidates)
+    : std::invalid_argument(
+          [&]
+          {
+              std::string msg = "Ambiguous option " + std::string(arg) + ":";
+              for (const auto &candidate : candidates)
+              {
+                  msg += " " + candidate;
+              }
+              return msg;
+          }()),
+      candidates(std::move(candidates))
+{
+}
+
+inline const std::vector<std::string> &AmbiguousOptionError::get_candidates()
+    const
+{
+    return this->candidates;
+}
+
+inline unrecognised_views::unrecognised_views(
+    std::pmr::memory_resource *resource)
+    : args(resource), files(resource)
+{
+}
+
+inline const std::string_view *unrecognised_views::begin() const
+{
+    return this->args.data();
+}
+
+inline const std::string_view *unrecognised_views::end() const
+{
+    return this->args.data() + this->args.size();
+}
+
+inline size_t unrecognised_views::size() const { return this->args.size(); }
+
+inline bool unrecognised_views::empty() const { return this->args.empty(); }
+
+inline const std::string_view &unrecognised_views::operator[](size_t i) const
+{
+    return this->args[i];
+}
+
+inline Parser::Parser(OptionsList options, unsigned flags /* = NONE */)
+    : options(std::move(options)),
+      parallel_opts(this->options.size()),
+      flags(flags),
+      threads(0),
+      split_opts(this->options),
+      required_opts(this->options.size()),
+      help_min_w(0),
+      help_width(0)
+{
+    this->profile_format = env_profile_format();
+    if (this->profile_format == ProfileFormat::NONE && (this->flags & PROFILE))
+    {
+        this->profile_format = ProfileFormat::TEXT;
+    }
+
+    this->collect_stats = this->profile_format != ProfileFormat::NONE;
+    ARGP_INSTRUMENT_HOOK(this->collect_stats = true;)
+    this->stats.reset(this->options.size());
+
+    for (size_t id = 0; id < this->options.size(); id++)
+    {
+        OptionBase *opt = this->options[id];
+        this->option_types.push_back(opt->get_type());
+        if (opt->get_type() == split_options::Type::POSITIONAL)
+        {
+            auto positional = static_cast<PositionalOptionBase *>(opt);
+            this->positional_ids.push_back(id);
+            this->positional_arities.push_back(positional->get_arity());
+            if ((this->flags & REQUIRED_POSITIONALS) &&
+                positional->get_required())
+            {
+                this->required_opts.insert(id);
+            }
+            continue;
+        }
+
+        auto keyword = static_cast<KeywordOptionBase *>(opt);
+        if (keyword->converts_in_parallel())
+        {
+            this->parallel_opts.insert(id);
+        }
+        if (!keyword->has_exact_identifiers())
+        {
+            this->keyword_fallback.push_back(id);
+            continue;
+        }
+
+        // insert keeps the first option registered for an identifier
+        int param_count = keyword->get_param_count();
+        for (const auto &identifier : keyword->get_identifiers())
+        {
+            this->keywords.insert(identifier, id, param_count);
+        }
+    }
+
+    if (this->flags & BUNDLED_FLAGS)
+    {
+        this->short_options.assign(256, {NO_MATCH, 0, 0});
+    }
+
+    for (size_t e = 0; e < this->keywords.size(); e++)
+    {
+        std::string_view identifier = this->keywords.identifier(e);
+        size_t id                   = this->keywords.id(e);
+        if (identifier.size() > 2 && identifier.compare(0, 2, "--") == 0)
+        {
+            this->long_identifiers.push_back(e);
+        }
+        else if (!this->short_options.empty() && identifier.size() == 2 &&
+                 identifier[0] == '-' && identifier[1] != '-')
+        {
+            auto c                 = static_cast<unsigned char>(identifier[1]);
+            this->short_options[c] = {id, this->keywords.param_count(e), e};
+        }
+    }
+
+    std::sort(this->long_identifiers.begin(), this->long_identifiers.end(),
+              [&](size_t lhs, size_t rhs)
+              {
+                  return this->keywords.identifier(lhs) <
+                         this->keywords.identifier(rhs);
+              });
+}
+
+inline size_t Parser::match_option(std::string_view arg) const
+{
+    size_t id = this->match_keyword(arg);
+    if (id != NO_MATCH)
+    {
+        return id;
+    }
+
+    size_t cursor = 0;
+    return this->match_positional(arg, cursor, nullptr);
+}
+
+inline size_t Parser::match_keyword(std::string_view arg) const
+{
+    ARGP_INSTRUMENT_HOOK(this->count(&ParseStats::index_lookups);)
+
+    size_t entry = this->keywords.find(arg);
+    size_t limit = (entry != impl::identifier_table::NO_ENTRY)
+                       ? this->keywords.id(entry)
+                       : NO_MATCH;
+
+    for (size_t id : this->keyword_fallback)
+    {
+        if (id > limit)
+        {
+            break;
+        }
+        ARGP_INSTRUMENT_HOOK(this->count(&ParseStats::matches_calls);)
+        if (this->options[id]->matches(arg))
+        {
+            return id;
+        }
+    }
+
+    return limit;
+}
+
+inline size_t Parser::match_positional(std::string_view arg, size_t &cursor,
+                                       const impl::option_set *given) const
+{
+    using Arity = PositionalOptionBase::Arity;
+
+    auto is_set = [&](size_t id)
+    {
+        return (given != nullptr) ? given->contains(id)
+                                  : this->options[id]->is_set();
+    };
+
+    // options of SINGLE arity can't match again once they are set
+    while (cursor < this->positional_ids.size() &&
+           this->positional_arities[cursor] == Arity::SINGLE &&
+           is_set(this->positional_ids[cursor]))
+    {
+        cursor++;
+    }
+
+    for (size_t k = cursor; k < this->positional_ids.size(); k++)
+    {
+        size_t id = this->positional_ids[k];
+        switch (this->positional_arities[k])
+        {
+        case Arity::SINGLE:
+            if (!is_set(id))
+            {
+                return id;
+            }
+            break;
+        case Arity::LIST:
+            return id;
+        case Arity::CUSTOM:
+            ARGP_INSTRUMENT_HOOK(this->count(&ParseStats::matches_calls);)
+            if (this->options[id]->matches(arg))
+            {
+                return id;
+            }
+            break;
+        }
+    }
+
+    return NO_MATCH;
+}
+
+inline void Parser::dispatch_list(size_t id, size_t &i, arg_span args,
+                                  const parse_state &state) const
+{
+    size_t end = i + 1;
+    while (end < args.size() && !args[end].empty() && args[end][0] != '-' &&
+           this->match_keyword(args[end]) == NO_MATCH)
+    {
+        end++;
+    }
+
+    impl::conversion_timer timer(this->stats_of(id));
+
+    if (state.storage != nullptr)
+    {
+        state.storage->slots[id]->convert(args.subspan(i, end - i),
+                                          state.storage->values);
+    }
+    else
+    {
+        this->options[id]->parse(args.subspan(i, end - i));
+    }
+
+    timer.stop(end - i);
+
+    i = end - 1;
+}
+
+inline std::pair<const size_t *, const size_t *> Parser::prefix_range(
+    std::string_view prefix) const
+{
+    const size_t *first = this->long_identifiers.data();
+    const size_t *last  = first + this->long_identifiers.size();
+
+    auto head = [&](size_t entry)
+    { return this->keywords.identifier(entry).substr(0, prefix.size()); };
+
+    const size_t *lower = std::lower_bound(
+        first, last, prefix,
+        [&](size_t entry, std::string_view str) { return head(entry) < str; });
+    const size_t *upper = std::upper_bound(
+        lower, last, prefix,
+        [&](std::string_view str, size_t entry) { return str < head(entry); });
+
+    return {lower, upper};
+}
+
+inline size_t Parser::match_abbreviation(std::string_view prefix) const
+{
+    if (prefix.size() <= 2 || prefix.compare(0, 2, "--") != 0)
+    {
+        return impl::identifier_table::NO_ENTRY;
+    }
+
+    auto [first, last] = this->prefix_range(prefix);
+    if (first == last)
+    {
+        return impl::identifier_table::NO_ENTRY;
+    }
+
+    size_t id = this->keywords.id(*first);
+    for (auto it = first; it != last; ++it)
+    {
+        if (this->keywords.id(*it) != id)
+        {
+            std::vector<std::string> candidates;
+            for (it = first; it != last; ++it)
+            {
+                candidates.emplace_back(this->keywords.identifier(*it));
+            }
+            throw AmbiguousOptionError(prefix, std::move(candidates));
+        }
+    }
+
+    return *first;
+}
+
+inline bool Parser::match_extended(size_t &i, arg_span args,
+                                   parse_state &state) const
+{
+    std::string_view name = args[i];
+    std::string_view value;
+    bool has_value = false;
+
+    if ((this->flags & INLINE_VALUES) && name.size() > 1 && name[0] == '-')
+    {
+        size_t eq = name.find('=');
+        if (eq != std::string_view::npos)
+        {
+            value     = name.substr(eq + 1);
+            name      = name.substr(0, eq);
+            has_value = true;
+        }
+    }
+
+    size_t id = has_value ? this->match_keyword(name) : NO_MATCH;
+    if (id == NO_MATCH && (this->flags & ABBREVIATIONS))
+    {
+        // options get the identifier they declared, not the abbreviation
+        size_t entry = this->match_abbreviation(name);
+        if (entry != impl::identifier_table::NO_ENTRY)
+        {
+            id   = this->keywords.id(entry);
+            name = this->keywords.identifier(entry);
+        }
+    }
+    if (id == NO_MATCH)
+    {
+        return false;
+    }
+
+    this->dispatch_as(id, name, has_value ? &value : nullptr, i, args, state);
+
+    return true;
+}
+
+inline bool Parser::match_bundle(size_t &i, arg_span args,
+                                 parse_state &state) const
+{
+    std::string_view arg = args[i];
+    if (arg.size() < 3 || arg[0] != '-' || arg[1] == '-')
+    {
+        return false;
+    }
+
+    // check the whole bundle first, so it is not applied only partially
+    for (size_t k = 1; k < arg.size(); k++)
+    {
+        const short_option &opt =
+            this->short_options[static_cast<unsigned char>(arg[k])];
+        if (opt.id == NO_MATCH)
+        {
+            return false;
+        }
+        if (opt.param_count == 0)
+        {
+            continue;
+        }
+
+        // same checks as dispatch_as does for the last option
+        int param_count = this->options[opt.id]->get_param_count();
+        if (param_count < -1)
+        {
+            throw std::invalid_argument(
+                "Invalid number of requested parameters.");
+        }
+        size_t given = (k + 1 < arg.size()) ? 1 : 0;
+        if (param_count != -1 &&
+            static_cast<size_t>(param_count) - given > args.size() - i - 1)
+        {
+            throw std::out_of_range("Not enough arguments.");
+        }
+        break;
+    }
+
+    for (size_t k = 1; k < arg.size(); k++)
+    {
+        const short_option &opt =
+            this->short_options[static_cast<unsigned char>(arg[k])];
+
+        if (opt.param_count == 0)
+        {
+            this->dispatch_as(opt.id, this->keywords.identifier(opt.entry),
+                              nullptr, i, args, state);
+            continue;
+        }
+
+        std::string_view rest = arg.substr(k + 1);
+        this->dispatch_as(opt.id, this->keywords.identifier(opt.entry),
+                          rest.empty() ? nullptr : &rest, i, args, state);
+        break;
+    }
+
+    return true;
+}
+
+inline void Parser::dispatch(size_t id, size_t &i, arg_span args,
+                             parse_state &state) const
+{
+    if (state.set_opts != nullptr)
+    {
+        state.set_opts->insert(id);
+    }
+
+    if (state.defer && this->parallel_opts.contains(id))
+    {
+        size_t count = impl::param_span(i, this->options[id], args) + 1;
+
+        // parameters not in the parsed arguments are on the stack, keep them
+        bool pooled   = args.begin() != state.args.begin();
+        size_t offset = i;
+        if (pooled)
+        {
+            offset = state.deferred_params.size();
+            state.deferred_params.insert(state.deferred_params.end(),
+                                         args.begin() + i,
+                                         args.begin() + i + count);
+        }
+
+        state.deferred.push_back({id, state.position, offset, count, pooled});
+        i += count - 1;
+        return;
+    }
+
+    impl::conversion_timer timer(this->stats_of(id));
+
+    if (state.storage != nullptr)
+    {
+        size_t count = impl::param_span(i, this->options[id], args);
+        state.storage->slots[id]->convert(args.subspan(i, count + 1),
+                                          state.storage->values);
+        i += count;
+    }
+    else
+    {
+        impl::handle_match(i, this->options[id], args);
+    }
+
+    timer.stop(1);
+}
+
+inline void Parser::dispatch_as(size_t id, std::string_view identifier,
+                                const std::string_view *value, size_t &i,
+                                arg_span args, parse_state &state) const
+{
+    int param_count = this->options[id]->get_param_count();
+    if (param_count < -1)
+    {
+        // let handle_match report the error
+        this->dispatch(id, i, args, state);
+        return;
+    }
+    if (value != nullptr && param_count == 0)
+    {
+        throw std::invalid_argument("Option does not take a value: " +
+                                    std::string(identifier));
+    }
+
+    size_t given     = (value != nullptr) ? 1 : 0;
+    size_t remaining = args.size() - i - 1;
+    size_t extra     = (param_count == -1)
+                           ? remaining
+                           : static_cast<size_t>(param_count) - given;
+    if (extra > remaining)
+    {
+        throw std::out_of_range("Not enough arguments.");
+    }
+
+    size_t j = 0;
+    if (given + extra <= 1)
+    {
+        // common case, the parameters fit on the stack
+        std::string_view small[2] = {identifier};
+        if (given + extra == 1)
+        {
+            small[1] = (value != nullptr) ? *value : args[i + 1];
+        }
+        this->dispatch(id, j, arg_span(small, 1 + given + extra), state);
+    }
+    else
+    {
+        std::vector<std::string_view> params = {identifier};
+        if (value != nullptr)
+        {
+            params.push_back(*value);
+        }
+        params.insert(params.end(), args.begin() + i + 1,
+                      args.begin() + i + 1 + extra);
+        this->dispatch(id, j, arg_span(params), state);
+    }
+
+    i += extra;
+}
+
+inline void Parser::convert_deferred(parse_state &state) const
+{
+    // group the matches by option, keeping their order (counting sort)
+    std::vector<size_t> group_start(this->options.size() + 1, 0);
+    for (const auto &match : state.deferred)
+    {
+        group_start[match.id + 1]++;
+    }
+    for (size_t id = 0; id < this->options.size(); id++)
+    {
+        group_start[id + 1] += group_start[id];
+    }
+
+    std::vector<arg_span> spans(state.deferred.size());
+    std::vector<size_t> positions(state.deferred.size());
+    std::vector<size_t> next(group_start.begin(), group_start.end() - 1);
+    for (const auto &match : state.deferred)
+    {
+        const std::string_view *params =
+            match.pooled ? state.deferred_params.data() + match.offset
+                         : state.args.begin() + match.offset;
+        size_t k     = next[match.id]++;
+        spans[k]     = arg_span(params, match.count);
+        positions[k] = match.position;
+    }
+
+    size_t max_threads = this->threads;
+    if (max_threads == 0)
+    {
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<size_t> large;
+    std::vector<size_t> small;
+    for (size_t id = 0; id < this->options.size(); id++)
+    {
+        size_t count = group_start[id + 1] - group_start[id];
+        if (count >= PARALLEL_MIN_OCCURRENCES)
+        {
+            large.push_back(id);
+        }
+        else if (count > 0)
+        {
+            small.push_back(id);
+        }
+    }
+
+    size_t no_error = static_cast<size_t>(-1);
+    std::vector<size_t> error_positions(this->options.size(), no_error);
+    std::vector<std::exception_ptr> errors(this->options.size());
+
+    auto convert_group = [&](size_t id, size_t threads)
+    {
+        size_t first  = group_start[id];
+        size_t count  = group_start[id + 1] - first;
+        size_t failed = 0;
+
+        std::chrono::steady_clock::time_point start;
+        if (this->collect_stats)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+        try
+        {
+            this->options[id]->parse_batch(spans.data() + first, count,
+                                           threads, failed);
+        }
+        catch (...)
+        {
+            error_positions[id] = positions[first + failed];
+            errors[id]          = std::current_exception();
+        }
+        if (this->collect_stats)
+        {
+            auto &opt_stats = this->stats.options[id];
+            opt_stats.conversions += count;
+            opt_stats.conversion_time +=
+                std::chrono::steady_clock::now() - start;
+        }
+    };
+
+    // large groups get all threads one after another, small ones share them
+    for (size_t id : large)
+    {
+        convert_group(id, max_threads);
+    }
+    impl::run_parallel(small.size(), max_threads,
+                       [&](size_t k) { convert_group(small[k], 1); });
+
+    size_t first_error = no_error;
+    for (size_t id = 0; id < this->options.size(); id++)
+    {
+        if (error_positions[id] < first_error)
+        {
+            first_error = error_positions[id];
+        }
+    }
+    if (first_error != no_error)
+    {
+        for (size_t id = 0; id < this->options.size(); id++)
+        {
+            if (error_positions[id] == first_error)
+            {
+                std::rethrow_exception(errors[id]);
+            }
+        }
+    }
+}
+
+template <class Fn>
+inline void Parser::parse_arg(size_t &i, arg_span args, parse_state &state,
+                              Fn &&unrecognised) const
+{
+    ARGP_INSTRUMENT_HOOK(this->count(&ParseStats::match_attempts);)
+
+    bool extended = this->flags & (ABBREVIATIONS | INLINE_VALUES);
+    bool bundled  = this->flags & BUNDLED_FLAGS;
+
+    size_t id = this->match_keyword(args[i]);
+    if (id == NO_MATCH && extended && this->match_extended(i, args, state))
+    {
+        return;
+    }
+    if (id == NO_MATCH && bundled && this->match_bundle(i, args, state))
+    {
+        return;
+    }
+    if (id == NO_MATCH)
+    {
+        size_t &cursor = state.positional_cursor;
+        id = this->match_positional(args[i], cursor, state.set_opts);
+
+        // the run can't skip options before the list, which may match
+        using Arity = PositionalOptionBase::Arity;
+        if (id != NO_MATCH && cursor < this->positional_ids.size() &&
+            this->positional_ids[cursor] == id &&
+            this->positional_arities[cursor] == Arity::LIST)
+        {
+            if (state.set_opts != nullptr)
+            {
+                state.set_opts->insert(id);
+            }
+            this->dispatch_list(id, i, args, state);
+            return;
+        }
+    }
+
+    if (id != NO_MATCH)
+    {
+        this->dispatch(id, i, args, state);
+    }
+    else if constexpr (std::is_same_v<
+                           std::invoke_result_t<Fn &, std::string_view>, bool>)
+    {
+        state.stop = unrecognised(args[i]);
+    }
+    else
+    {
+        unrecognised(args[i]);
+    }
+}
+
+template <class Fn>
+inline void Parser::parse_args(
+    arg_span args, impl::option_set *set_opts, Fn &&unrecognised,
+    const impl::value_storage *storage /* = nullptr */) const
+{
+    // batch conversion works on the options, it is not used for storage
+    bool defer = (this->flags & PARALLEL_CONVERSION) && storage == nullptr;
+    parse_state state{args, 0, defer, {}, {}};
+    state.set_opts = set_opts;
+    state.storage  = storage;
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        state.position = i;
+        this->parse_arg(i, args, state, unrecognised);
+        if (state.stop)
+        {
+            for (i++; i < args.size(); i++)
+            {
+                unrecognised(args[i]);
+            }
+        }
+    }
+
+    if (state.defer)
+    {
+        this->convert_deferred(state);
+    }
+}
+
+inline size_t Parser::lookahead() const
+{
+    size_t max_count = 0;
+    for (OptionBase *opt : this->options)
+    {
+        int count = opt->get_param_count();
+        if (count == -1)
+        {
+            return static_cast<size_t>(-1);
+        }
+        max_count =
+            std::max(max_count, static_cast<size_t>(std::max(count, 0)));
+    }
+
+    return max_count;
+}
+
+inline void Parser::add_arg(std::string_view arg,
+                            std::pmr::vector<std::string_view> &args,
+                            std::pmr::vector<impl::mapped_file> &files,
+                            int depth) const
+{
+    if (!(this->flags & RESPONSE_FILES) || arg.size() < 2 || arg[0] != '@')
+    {
+        args.push_back(arg);
+        return;
+    }
+
+    if (depth >= MAX_RESPONSE_FILE_DEPTH)
+    {
+        throw std::invalid_argument("Response files are nested too deeply.");
+    }
+    if (files.size() >= MAX_RESPONSE_FILES)
+    {
+        throw std::invalid_argument("Too many response files.");
+    }
+
+    try
+    {
+        files.emplace_back(std::string(arg.substr(1)));
+    }
+    catch (const std::invalid_argument &)
+    {
+        // same as GCC and Clang, unreadable files are kept as arguments
+        args.push_back(arg);
+        return;
+    }
+    const impl::mapped_file &file = files.back();
+
+    std::pmr::vector<std::string_view> file_args(args.get_allocator());
+    impl::tokenize_response_file(file.data(), file.size(), file_args);
+
+    for (auto file_arg : file_args)
+    {
+        this->add_arg(file_arg, args, files, depth + 1);
+    }
+}
+
+template <class Fn>
+inline void Parser::parse_argv(int argc, const char *argv[], int skip_first_n,
+                               std::pmr::vector<impl::mapped_file> &files,
+                               std::pmr::memory_resource *resource,
+                               impl::option_set *set_opts,
+                               Fn &&unrecognised,
+                               const impl::value_storage *storage
+                               /* = nullptr */) const
+{
+    size_t allocs_start = 0;
+    std::chrono::steady_clock::time_point start;
+    if (this->collect_stats)
+    {
+        this->stats.reset(this->options.size());
+        ARGP_INSTRUMENT_HOOK(this->stats.counted = true;)
+        allocs_start = instrument::allocations();
+        start        = std::chrono::steady_clock::now();
+    }
+
+    // views are created once, so matched options get them without allocation
+    std::pmr::vector<std::string_view> args(resource);
+    if (skip_first_n < argc)
+    {
+        if (this->flags & RESPONSE_FILES)
+        {
+            for (int i = skip_first_n; i < argc; i++)
+            {
+                this->add_arg(argv[i], args, files, 0);
+            }
+        }
+        else
+        {
+            args.assign(argv + skip_first_n, argv + argc);
+        }
+    }
+
+    if (this->collect_stats)
+    {
+        this->stats.tokenize_time = std::chrono::steady_clock::now() - start;
+    }
+
+    this->parse_args(arg_span(args.data(), args.size()), set_opts,
+                     unrecognised, storage);
+
+    if (this->collect_stats)
+    {
+        this->finish_stats(args.size(), allocs_start, start);
+    }
+}
+
+inline std::vector<std::string> Parser::parse(int argc, const char *argv[],
+                                              int skip_first_n /* = 1 */) const
+{
+    std::vector<std::string> unrecognised;
+    std::pmr::vector<impl::mapped_file> files;
+    bool track = this->has_constraints();
+    impl::option_set set_opts(track ? this->options.size() : 0);
+
+    this->parse_argv(argc, argv, skip_first_n, files,
+                     std::pmr::get_default_resource(),
+                     track ? &set_opts : nullptr,
+                     [&](std::string_view arg)
+                     { unrecognised.push_back(std::string(arg)); });
+
+    if (track)
+    {
+        this->check_constraints(set_opts);
+    }
+
+    return unrecognised;
+}
+
+template <class Pred>
+inline std::vector<std::string> Parser::parse_until(
+    int argc, const char *argv[], int skip_first_n, Pred &&is_end,
+    std::vector<std::string> &rest) const
+{
+    std::vector<std::string> unrecognised;
+    std::pmr::vector<impl::mapped_file> files;
+    bool track = this->has_constraints();
+    impl::option_set set_opts(track ? this->options.size() : 0);
+
+    bool stopped = false;
+    this->parse_argv(argc, argv, skip_first_n, files,
+                     std::pmr::get_default_resource(),
+                     track ? &set_opts : nullptr,
+                     [&](std::string_view arg)
+                     {
+                         stopped = stopped || is_end(arg);
+                         (stopped ? rest : unrecognised)
+                             .push_back(std::string(arg));
+                         return stopped;
+                     });
+
+    if (track)
+    {
+        this->check_constraints(set_opts);
+    }
+
+    return unrecognised;
+}
+
+inline unrecognised_views Parser::parse_views(
+    int argc, const char *argv[], int skip_first_n /* = 1 */,
+    std::pmr::memory_resource *resource
+    /* = std::pmr::get_default_resource() */) const
+{
+    unrecognised_views res(resource);
+    bool track = this->has_constraints();
+    impl::option_set set_opts(track ? this->options.size() : 0);
+
+    this->parse_argv(argc, argv, skip_first_n, res.files, resource,
+                     track ? &set_opts : nullptr,
+                     [&](std::string_view arg) { res.args.push_back(arg); });
+
+    if (track)
+    {
+        this->check_constraints(set_opts);
+    }
+
+    return res;
+}
+
+inline void Parser::parse_into(parse_result &res, int argc,
+                               const char *argv[],
+                               int skip_first_n /* = 1 */) const
+{
+    std::pmr::vector<impl::mapped_file> files;
+    res.unrecognised.clear();
+    res.given.assign(this->options.size());
+    res.options = &this->options;
+
+    this->parse_argv(argc, argv, skip_first_n, files,
+                     std::pmr::get_default_resource(), &res.given,
+                     [&](std::string_view arg)
+                     { res.unrecognised.push_back(std::string(arg)); });
+
+    if (this->has_constraints())
+    {
+        this->check_constraints(res.given);
+    }
+}
+
+inline void Parser::apply_value(size_t id, std::string_view value,
+                                bool has_value,
+                                impl::option_set *set_opts) const
+{
+    OptionBase *opt = this->options[id];
+
+    // options with custom matching may have no identifiers
+    const auto &identifiers =
+        static_cast<KeywordOptionBase *>(opt)->get_identifiers();
+    std::string_view params[2] = {
+        identifiers.empty() ? std::string_view() : identifiers.front(), value};
+
+    int param_count = opt->get_param_count();
+    if (param_count == 0)
+    {
+        if (!has_value || value == "1" || value == "true" || value == "yes" ||
+            value == "on")
+        {
+            opt->parse(arg_span(params, 1));
+            if (set_opts != nullptr)
+            {
+                set_opts->insert(id);
+            }
+        }
+        else if (value != "0" && value != "false" && value != "no" &&
+                 value != "off")
+        {
+            throw std::invalid_argument("Invalid value of option " +
+                                        std::string(params[0]) + ": " +
+                                        std::string(value));
+        }
+    }
+    else if (param_count == 1)
+    {
+        opt->parse(arg_span(params, 2));
+        opt->validate();
+        if (set_opts != nullptr)
+        {
+            set_opts->insert(id);
+        }
+    }
+    else
+    {
+        throw std::invalid_argument("Option can be given only in arguments: " +
+                                    std::string(params[0]));
+    }
+}
+
+inline std::vector<std::string> Parser::parse_layered(
+    int argc, const char *argv[], const layered_sources &sources,
+    int skip_first_n /* = 1 */) const
+{
+    std::vector<std::string> unrecognised;
+    std::pmr::vector<impl::mapped_file> files;
+    bool track = this->has_constraints();
+    impl::option_set set_opts(track ? this->options.size() : 0);
+
+    this->parse_argv(argc, argv, skip_first_n, files,
+                     std::pmr::get_default_resource(),
+                     track ? &set_opts : nullptr,
+                     [&](std::string_view arg)
+                     { unrecognised.push_back(std::string(arg)); });
+
+    // winning value of every option not set from argv
+    struct layer_value
+    {
+        bool found;
+        bool has_value;
+        std::string_view value;
+    };
+    std::vector<layer_value> values(this->options.size(), {false, false, {}});
+
+    std::string name;
+    if (!sources.config_file.empty())
+    {
+        try
+        {
+            files.emplace_back(sources.config_file);
+        }
+        catch (const std::invalid_argument &)
+        {
+            throw std::invalid_argument("Could not read config file: " +
+                                        sources.config_file);
+        }
+
+        std::string_view data(files.back().data(), files.back().size());
+        impl::parse_config(
+            data,
+            [&](std::string_view key, std::string_view value, bool has_value)
+            {
+                size_t id = this->match_keyword(key);
+                if (id == NO_MATCH)
+                {
+                    name.assign("--").append(key);
+                    id = this->match_keyword(name);
+                }
+
+                if (id == NO_MATCH ||
+                    this->option_types[id] != split_options::Type::KEYWORD)
+                {
+                    unrecognised.push_back(std::string(key));
+                }
+                else if (!this->options[id]->is_set())
+                {
+                    values[id] = {true, has_value, value};
+                }
+            });
+    }
+
+    if (!sources.env_prefix.empty())
+    {
+        for (size_t entry : this->long_identifiers)
+        {
+            std::string_view identifier = this->keywords.identifier(entry);
+            size_t id                   = this->keywords.id(entry);
+            if (this->options[id]->is_set())
+            {
+                continue;
+            }
+
+            name = sources.env_prefix;
+            for (char c : identifier.substr(2))
+            {
+                if (c == '-')
+                {
+                    c = '_';
+                }
+                else if (c >= 'a' && c <= 'z')
+                {
+                    c = static_cast<char>(c - 'a' + 'A');
+                }
+                name += c;
+            }
+            if (const char *value = std::getenv(name.c_str()))
+            {
+                values[id] = {true, true, value};
+            }
+        }
+    }
+
+    for (size_t id = 0; id < this->options.size(); id++)
+    {
+        if (values[id].found)
+        {
+            this->apply_value(id, values[id].value, values[id].has_value,
+                              track ? &set_opts : nullptr);
+        }
+    }
+
+    if (track)
+    {
+        this->check_constraints(set_opts);
+    }
+
+    return unrecognised;
+}
+
+template <class It>
+inline std::vector<std::string> Parser::parse(It first, It last) const
+{
+    return this->parse_stream(
+        [&](std::string &token)
+        {
+            if (first == last)
+            {
+                return false;
+            }
+            token.assign(std::string_view(*first));
+            ++first;
+            return true;
+        });
+}
+
+template <class Source>
+inline std::vector<std::string> Parser::parse_stream(Source &&next) const
+{
+    size_t allocs_start = 0;
+    std::chrono::steady_clock::time_point start;
+    if (this->collect_stats)
+    {
+        this->stats.reset(this->options.size());
+        ARGP_INSTRUMENT_HOOK(this->stats.counted = true;)
+        allocs_start = instrument::allocations();
+        start        = std::chrono::steady_clock::now();
+    }
+
+    std::vector<std::string> unrecognised;
+    auto add_unrecognised = [&](std::string_view arg)
+    { unrecognised.push_back(std::string(arg)); };
+
+    std::vector<std::string> tokens;
+    std::vector<std::string_view> window;
+    parse_state state{arg_span(), 0, false, {}, {}};
+    bool track = this->has_constraints();
+    impl::option_set set_opts(track ? this->options.size() : 0);
+    state.set_opts = track ? &set_opts : nullptr;
+
+    size_t window_size = this->lookahead();
+    bool more          = true;
+    if (window_size == static_cast<size_t>(-1))
+    {
+        // an option may take all remaining arguments, so read all of them
+        auto read_start = std::chrono::steady_clock::time_point();
+        if (this->collect_stats)
+        {
+            read_start = std::chrono::steady_clock::now();
+        }
+        std::string token;
+        while (next(token))
+        {
+            tokens.push_back(std::move(token));
+        }
+        window.assign(tokens.begin(), tokens.end());
+        more = false;
+        if (this->collect_stats)
+        {
+            this->stats.tokenize_time +=
+                std::chrono::steady_clock::now() - read_start;
+        }
+    }
+    else
+    {
+        window_size++;
+    }
+
+    // number of tokens at the front of the window, which were already parsed
+    size_t parsed = 0;
+    while (true)
+    {
+        if (more && tokens.size() - parsed < window_size)
+        {
+            auto read_start = std::chrono::steady_clock::time_point();
+            if (this->collect_stats)
+            {
+                read_start = std::chrono::steady_clock::now();
+            }
+            tokens.erase(tokens.begin(), tokens.begin() + parsed);
+            parsed = 0;
+
+            std::string token;
+            while (tokens.size() < window_size && (more = next(token)))
+            {
+                tokens.push_back(std::move(token));
+            }
+            window.assign(tokens.begin(), tokens.end());
+            if (this->collect_stats)
+            {
+                this->stats.tokenize_time +=
+                    std::chrono::steady_clock::now() - read_start;
+            }
+        }
+        if (parsed == tokens.size())
+        {
+            break;
+        }
+
+        state.args = arg_span(window).subspan(parsed, window.size() - parsed);
+
+        size_t i = 0;
+        this->parse_arg(i, state.args, state, add_unrecognised);
+
+        state.position += i + 1;
+        parsed += i + 1;
+    }
+
+    if (this->collect_stats)
+    {
+        this->finish_stats(state.position, allocs_start, start);
+    }
+
+    if (track)
+    {
+        this->check_constraints(set_opts);
+    }
+
+    return unrecognised;
+}
+
+inline size_t Parser::find_id(const OptionBase *opt) const
+{
+    auto it = std::find(this->options.begin(), this->options.end(), opt);
+    if (it == this->options.end())
+    {
+        throw std::invalid_argument("Option is not known to the parser.");
+    }
+
+    return static_cast<size_t>(it - this->options.begin());
+}
+
+inline bool Parser::has_constraints() const
+{
+    return !this->required_opts.empty() || !this->exclusive_groups.empty() ||
+           !this->dependencies.empty();
+}
+
+inline void Parser::check_constraints(const impl::option_set &set_opts) const
+{
+    size_t missing = set_opts.first_missing(this->required_opts);
+    if (missing != NO_MATCH)
+    {
+        throw std::invalid_argument("Missing required option: " +
+                                    this->options[missing]->get_help().first);
+    }
+
+    for (const impl::option_set &group : this->exclusive_groups)
+    {
+        if (!set_opts.has_several_common(group))
+        {
+            continue;
+        }
+
+        std::string names;
+        for (size_t id = 0; id < this->options.size(); id++)
+        {
+            if (group.contains(id) && set_opts.contains(id))
+            {
+                names += names.empty() ? "" : "; ";
+                names += this->options[id]->get_help().first;
+            }
+        }
+        throw std::invalid_argument("Options can't be used together: " +
+                                    names);
+    }
+
+    for (const auto &[id, required] : this->dependencies)
+    {
+        if (!set_opts.contains(id))
+        {
+            continue;
+        }
+
+        missing = set_opts.first_missing(required);
+        if (missing != NO_MATCH)
+        {
+            throw std::invalid_argument(
+                "Option " + this->options[id]->get_help().first +
+                " requires " + this->options[missing]->get_help().first);
+        }
+    }
+}
+
+inline const OptionsList &Parser::get_options() const { return this->options; }
+
+inline void Parser::add_required(const OptionBase *opt)
+{
+    this->required_opts.insert(this->find_id(opt));
+}
+
+inline void Parser::add_exclusive(const OptionsList &opts)
+{
+    impl::option_set group(this->options.size());
+    for (const OptionBase *opt : opts)
+    {
+        group.insert(this->find_id(opt));
+    }
+    this->exclusive_groups.push_back(std::move(group));
+}
+
+inline void Parser::add_dependency(const OptionBase *opt,
+                                   const OptionsList &required)
+{
+    impl::option_set group(this->options.size());
+    for (const OptionBase *req : required)
+    {
+        group.insert(this->find_id(req));
+    }
+    this->dependencies.emplace_back(this->find_id(opt), std::move(group));
+}
+
+inline const std::string &Parser::help(std::string_view cmd,
+                                       size_t min_w /* = 25 */,
+                                       size_t width /* = 0 */) const
+{
+    if (this->help_cache.empty() || this->help_cmd != cmd ||
+        this->help_min_w != min_w || this->help_width != width)
+    {
+        this->help_cache = help_string(cmd, this->options, min_w, width);
+        this->help_cmd   = cmd;
+        this->help_min_w = min_w;
+        this->help_width = width;
+    }
+
+    return this->help_cache;
+}
+
+inline std::vector<std::string_view> Parser::complete(
+    std::string_view partial) const
+{
+    auto starts_with = [](std::string_view str, std::string_view prefix)
+    { return str.substr(0, prefix.size()) == prefix; };
+
+    std::vector<std::string_view> res;
+    auto [first, last] = this->prefix_range(partial);
+    for (auto it = first; it != last; ++it)
+    {
+        res.push_back(this->keywords.identifier(*it));
+    }
+
+    // identifiers not in long_identifiers are few, check them all
+    for (size_t e = 0; e < this->keywords.size(); e++)
+    {
+        std::string_view identifier = this->keywords.identifier(e);
+        bool is_long = identifier.size() > 2 && starts_with(identifier, "--");
+        if (!is_long && starts_with(identifier, partial))
+        {
+            res.push_back(identifier);
+        }
+    }
+
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+inline bool Parser::print_completions(int argc, const char *argv[],
+                                      std::ostream &os,
+                                      int skip_first_n /* = 1 */) const
+{
+    if (skip_first_n >= argc || argv[skip_first_n] != COMPLETE_ARG)
+    {
+        return false;
+    }
+
+    std::string_view partial =
+        (skip_first_n + 1 < argc) ? argv[skip_first_n + 1] : "";
+
+    std::string out;
+    for (std::string_view candidate : this->complete(partial))
+    {
+        out += candidate;
+        out += '\n';
+    }
+    os.write(out.data(), out.size());
+
+    return true;
+}
+
+inline std::string Parser::completion_script(std::string_view cmd,
+                                             Shell shell) const
+{
+    struct entry
+    {
+        std::string_view identifier;
+        int param_count;
+        std::string help;
+    };
+
+    // identifiers in the index, each with the option that owns it
+    std::vector<entry> entries;
+    for (size_t id = 0; id < this->options.size(); id++)
+    {
+        if (this->option_types[id] != split_options::Type::KEYWORD)
+        {
+            continue;
+        }
+        auto keyword     = static_cast<KeywordOptionBase *>(this->options[id]);
+        std::string help = keyword->get_help().second;
+        for (const auto &identifier : keyword->get_identifiers())
+        {
+            size_t e = this->keywords.find(identifier);
+            if (e != impl::identifier_table::NO_ENTRY &&
+                this->keywords.id(e) == id)
+            {
+                entries.push_back({this->keywords.identifier(e),
+                                   this->keywords.param_count(e), help});
+            }
+        }
+    }
+
+    std::string name;
+    for (char c : cmd)
+    {
+        name += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+
+    std::string out;
+    switch (shell)
+    {
+    case Shell::BASH:
+    {
+        std::string words;
+        std::string with_values;
+        for (const entry &e : entries)
+        {
+            words += words.empty() ? "" : " ";
+            words += e.identifier;
+            if (e.param_count != 0)
+            {
+                with_values += with_values.empty() ? "" : "|";
+                impl::append_shell_quoted(with_values, e.identifier);
+            }
+        }
+
+        out += "# bash completion for ";
+        out += cmd;
+        out += "\n_argp_" + name + "()\n{\n";
+        out += "    local cur=\"${COMP_WORDS[COMP_CWORD]}\"\n";
+        out += "    COMPREPLY=()\n";
+        if (!with_values.empty())
+        {
+            // files are completed by -o default for option values
+            out += "    case \"${COMP_WORDS[COMP_CWORD-1]}\" in\n        ";
+            out += with_values;
+            out += ") return ;;\n    esac\n";
+        }
+        out += "    COMPREPLY=($(compgen -W ";
+        impl::append_shell_quoted(out, words);
+        out += " -- \"$cur\"))\n}\n";
+        out += "complete -o default -F _argp_" + name + " ";
+        impl::append_shell_quoted(out, cmd);
+        out += '\n';
+        break;
+    }
+    case Shell::ZSH:
+    {
+        out += "#compdef ";
+        out += cmd;
+        out += "\n# zsh completion for ";
+        out += cmd;
+        out += "\n_arguments";
+        out += (this->flags & BUNDLED_FLAGS) ? " -s \\\n" : " \\\n";
+        for (const entry &e : entries)
+        {
+            // _arguments only accepts options starting with a dash
+            if (e.identifier.empty() || e.identifier[0] != '-')
+            {
+                continue;
+            }
+
+            // options may repeat, help can't contain unescaped `[]:\`
+            std::string spec = "*";
+            spec += e.identifier;
+            spec += '[';
+            for (char c : e.help)
+            {
+                if (c == '[' || c == ']' || c == ':' || c == '\\')
+                {
+                    spec += '\\';
+                }
+                spec += c;
+            }
+            spec += ']';
+            for (int k = 0; k < std::max(e.param_count, 0); k++)
+            {
+                spec += ":value:_files";
+            }
+            if (e.param_count == -1)
+            {
+                spec += ":*:value:_files";
+            }
+            out += "    ";
+            impl::append_shell_quoted(out, spec);
+            out += " \\\n";
+        }
+        out += "    '*:file:_files'\n";
+        break;
+    }
+    case Shell::FISH:
+    {
+        out += "# fish completion for ";
+        out += cmd;
+        out += '\n';
+        for (const entry &e : entries)
+        {
+            std::string_view identifier = e.identifier;
+            out += "complete -c ";
+            impl::append_shell_quoted(out, cmd);
+            if (identifier.size() > 2 && identifier.substr(0, 2) == "--")
+            {
+                out += " -l ";
+                impl::append_shell_quoted(out, identifier.substr(2));
+            }
+            else if (identifier.size() == 2 && identifier[0] == '-')
+            {
+                out += " -s ";
+                impl::append_shell_quoted(out, identifier.substr(1));
+            }
+            else if (identifier.size() > 1 && identifier[0] == '-')
+            {
+                out += " -o ";
+                impl::append_shell_quoted(out, identifier.substr(1));
+            }
+            else
+            {
+                out += " -f -a ";
+                impl::append_shell_quoted(out, identifier);
+            }
+            out += " -d ";
+            impl::append_shell_quoted(out, e.help);
+            out += (e.param_count != 0) ? " -r\n" : "\n";
+        }
+        break;
+    }
+    }
+
+    return out;
+}
+
+inline void Parser::validate_all() const { argp::validate_all(this->options); }
+
+inline void Parser::reset()
+{
+    for (OptionBase *opt : this->options)
+    {
+        opt->reset();
+    }
+}
+
+inline void Parser::set_threads(size_t threads) { this->threads = threads; }
+
+inline const ParseStats &Parser::get_stats() const { return this->stats; }
+
+inline Parser::ProfileFormat Parser::env_profile_format()
+{
+    static const ProfileFormat format = []
+    {
+        const char *env = std::getenv(PROFILE_ENV);
+        std::string_view profile = (env != nullptr) ? env : "";
+        if (profile == "json")
+        {
+            return ProfileFormat::JSON;
+        }
+        return (profile == "1") ? ProfileFormat::TEXT : ProfileFormat::NONE;
+    }();
+
+    return format;
+}
+
+inline ParseStats::option_stats *Parser::stats_of(size_t id) const
+{
+    return this->collect_stats ? &this->stats.options[id] : nullptr;
+}
+
+inline void Parser::count(size_t ParseStats::*counter) const
+{
+    if (this->collect_stats)
+    {
+        (this->stats.*counter)++;
+    }
+}
+
+inline size_t instrument::allocations()
+{
+    return (allocation_counter != nullptr) ? allocation_counter() : 0;
+}
+
+inline impl::conversion_timer::conversion_timer(
+    ParseStats::option_stats *stats)
+    : stats(stats), start(), allocs(0)
+{
+    if (this->stats != nullptr)
+    {
+        this->allocs = instrument::allocations();
+        this->start  = std::chrono::steady_clock::now();
+    }
+}
+
+inline void impl::conversion_timer::stop(size_t conversions)
+{
+    if (this->stats != nullptr)
+    {
+        this->stats->conversions += conversions;
+        this->stats->allocations += instrument::allocations() - this->allocs;
+        this->stats->conversion_time +=
+            std::chrono::steady_clock::now() - this->start;
+    }
+}
+
+inline void ParseStats::reset(size_t option_count)
+{
+    this->arguments      = 0;
+    this->match_attempts = 0;
+    this->index_lookups  = 0;
+    this->matches_calls  = 0;
+    this->allocations    = 0;
+    this->parse_time     = std::chrono::nanoseconds(0);
+    this->tokenize_time  = std::chrono::nanoseconds(0);
+    this->match_time     = std::chrono::nanoseconds(0);
+    this->options.assign(option_count, {0, 0, std::chrono::nanoseconds(0)});
+    this->counted = false;
+}
+
+inline void Parser::finish_stats(
+    size_t arguments, size_t allocs_start,
+    std::chrono::steady_clock::time_point start) const
+{
+    this->stats.arguments   = arguments;
+    this->stats.allocations = instrument::allocations() - allocs_start;
+    this->stats.parse_time  = std::chrono::steady_clock::now() - start;
+
+    // conversions of PARALLEL_CONVERSION overlap, the difference is only
+    // an estimate there
+    auto rest = this->stats.parse_time - this->stats.tokenize_time;
+    for (const auto &opt_stats : this->stats.options)
+    {
+        rest -= opt_stats.conversion_time;
+    }
+    this->stats.match_time = std::max(rest, std::chrono::nanoseconds(0));
+
+    if (this->profile_format != ProfileFormat::NONE)
+    {
+        std::string report =
+            profile_report(this->stats, this->options,
+                           this->profile_format == ProfileFormat::JSON);
+        std::fwrite(report.data(), 1, report.size(), stderr);
+    }
+}
+
+namespace impl
+{
+
+/**
+ * append_json_string
+ *
+ * Append `str` to `out` as a quoted and escaped JSON string.
+ */
+inline void append_json_string(std::string &out, std::string_view str)
+{
+    out += '"';
+    for (char c : str)
+    {
+        auto uc = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (uc < 0x20)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", uc);
+            out += buf;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace impl
+
+inline std::string profile_report(const ParseStats &stats,
+                                  const OptionsList &opts,
+                                  bool json /* = false */)
+{
+    std::vector<size_t> order;
+    for (size_t id = 0; id < stats.options.size() && id < opts.size(); id++)
+    {
+        if (stats.options[id].conversions > 0)
+        {
+            order.push_back(id);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t lhs, size_t rhs)
+                     {
+                         return stats.options[lhs].conversion_time >
+                                stats.options[rhs].conversion_time;
+                     });
+
+    std::chrono::nanoseconds convert_time(0);
+    for (const auto &opt_stats : stats.options)
+    {
+        convert_time += opt_stats.conversion_time;
+    }
+
+    auto number = [](auto value) { return std::to_string(value); };
+    auto ns     = [](std::chrono::nanoseconds value)
+    { return std::to_string(value.count()); };
+
+    std::string out;
+    if (json)
+    {
+        out += "{\"arguments\":" + number(stats.arguments);
+        out += ",\"parse_ns\":" + ns(stats.parse_time);
+        out += ",\"tokenize_ns\":" + ns(stats.tokenize_time);
+        out += ",\"match_ns\":" + ns(stats.match_time);
+        out += ",\"convert_ns\":" + ns(convert_time);
+        out += ",\"allocations\":" + number(stats.allocations);
+        out += ",\"match_attempts\":" + number(stats.match_attempts);
+        out += ",\"index_lookups\":" + number(stats.index_lookups);
+        out += ",\"matches_calls\":" + number(stats.matches_calls);
+        out += ",\"counted\":";
+        out += stats.counted ? "true" : "false";
+        out += ",\"options\":[";
+        for (size_t id : order)
+        {
+            const auto &opt_stats = stats.options[id];
+            out += (id == order.front()) ? "{\"name\":" : ",{\"name\":";
+            impl::append_json_string(out, opts[id]->get_help().first);
+            out += ",\"conversions\":" + number(opt_stats.conversions);
+            out += ",\"ns\":" + ns(opt_stats.conversion_time);
+            out += ",\"allocations\":" + number(opt_stats.allocations);
+            out += '}';
+        }
+        out += "]}\n";
+        return out;
+    }
+
+    out += "argp profile: " + number(stats.arguments) + " arguments, " +
+           ns(stats.parse_time) + " ns, " + number(stats.allocations) +
+           " allocations\n";
+    out += "  tokenize " + ns(stats.tokenize_time) + " ns\n";
+    out += "  match    " + ns(stats.match_time) + " ns";
+    if (stats.counted)
+    {
+        out += " (" + number(stats.match_attempts) + " attempts, " +
+               number(stats.index_lookups) + " index lookups, " +
+               number(stats.matches_calls) + " matches calls)";
+    }
+    else
+    {
+        out += " (define ARGP_INSTRUMENT to count matches)";
+    }
+    out += '\n';
+    out += "  convert  " + ns(convert_time) + " ns\n";
+
+    if (!order.empty())
+    {
+        std::string header[4] = {"option", "conversions", "ns",
+                                 "allocations"};
+        std::vector<std::array<std::string, 4>> rows;
+        std::array<size_t, 4> widths = {0, 0, 0, 0};
+        rows.push_back({header[0], header[1], header[2], header[3]});
+        for (size_t id : order)
+        {
+            const auto &opt_stats = stats.options[id];
+            rows.push_back({opts[id]->get_help().first,
+                            number(opt_stats.conversions),
+                            ns(opt_stats.conversion_time),
+                            number(opt_stats.allocations)});
+        }
+        for (const auto &row : rows)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                widths[c] = std::max(widths[c], row[c].size());
+            }
+        }
+
+        // names aligned left, numbers right
+        for (const auto &row : rows)
+        {
+            out += "  ";
+            out += row[0];
+            out.append(widths[0] - row[0].size(), ' ');
+            for (size_t c = 1; c < 4; c++)
+            {
+                out.append(widths[c] - row[c].size() + 2, ' ');
+                out += row[c];
+            }
+            out += '\n';
+        }
+    }
+
+    return out;
+}
+
+inline std::vector<std::string> parse(int argc, const char *argv[],
+                                      const OptionsList &opts,
+                                      int skip_first_n /* = 1 */,
+                                      unsigned flags /* = Parser::NONE */)
+{
+    return Parser(opts, flags).parse(argc, argv, skip_first_n);
+}
+
+inline void print_help(std::ostream &os, std::string_view cmd,
+                       const OptionsList &opts, size_t min_w /* = 25 */)
+{
+    os << help_string(cmd, opts, min_w, 0, os.fill());
+}
+
+inline std::string help_string(std::string_view cmd, const OptionsList &opts,
+                               size_t min_w /* = 25 */, size_t width /* = 0 */,
+                               char fill /* = ' ' */)
+{
+    std::vector<std::pair<std::string, std::string>> helps;
+    helps.reserve(opts.size());
+
+    bool has_keyword = false;
+    size_t length    = cmd.size() + 32;
+    for (OptionBase *opt : opts)
+    {
+        helps.push_back(opt->get_help());
+        has_keyword |= opt->get_type() == split_options::Type::KEYWORD;
+
+        const auto &help = helps.back();
+        length += std::max(help.first.size() + 2, min_w) + help.second.size() +
+                  help.first.size() + 2;
+    }
+
+    std::string out;
+    out.reserve(length);
+
+    out += "Usage: ";
+    out += cmd;
+    if (has_keyword)
+    {
+        out += " <options>";
+    }
+    for (size_t k = 0; k < opts.size(); k++)
+    {
+        if (opts[k]->get_type() == split_options::Type::POSITIONAL)
+        {
+            out += ' ';
+            out += helps[k].first;
+        }
+    }
+    out += "\nOptions:\n";
+
+    for (const auto &help : helps)
+    {
+        impl::append_help_line(out, help.first, help.second, min_w, width,
+                               fill);
+    }
+
+    return out;
+}
+
+inline size_t terminal_width()
+{
+    if (const char *columns = std::getenv("COLUMNS"))
+    {
+        size_t width = 0;
+        std::string_view str(columns);
+        auto res = std::from_chars(str.data(), str.data() + str.size(), width);
+        if (res.ec == std::errc() && width > 0)
+        {
+            return width;
+        }
+    }
+
+    // only POSIX terminals are asked, elsewhere (e.g. _WIN32) COLUMNS is used
+#if defined(TIOCGWINSZ) && defined(STDOUT_FILENO)
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+    {
+        return size.ws_col;
+    }
+#endif
+
+    return 0;
+}
+
+inline bool parse_result::is_set(const OptionBase *opt) const
+{
+    if (this->options == nullptr)
+    {
+        return false;
+    }
+
+    auto it = std::find(this->options->begin(), this->options->end(), opt);
+    if (it == this->options->end())
+    {
+        return false;
+    }
+
+    size_t id = static_cast<size_t>(it - this->options->begin());
+    return this->given.contains(id);
+}
+
+inline void validate_all(const OptionsList &opts)
+{
+    for (const OptionBase *opt : opts)
+    {
+        opt->validate();
+    }
+}
+
+inline stream_tokens::stream_tokens(std::istream &is,
+                                    char delimiter /* = '\0' */)
+    : is(is), delimiter(delimiter)
+{
+}
+
+inline bool stream_tokens::operator()(std::string &token)
+{
+    return static_cast<bool>(std::getline(this->is, token, this->delimiter));
+}
+
+inline unsigned Subcommand::get_flags() const { return Parser::NONE; }
+
+inline const SubcommandParser::entry *SubcommandParser::find(
+    std::string_view name) const
+{
+    auto it = std::lower_bound(this->commands.begin(), this->commands.end(),
+                               name, [](const entry &e, std::string_view name)
+                               { return e.name < name; });
+
+    return (it != this->commands.end() && it->name == name) ? &*it : nullptr;
+}
+
+inline SubcommandParser::SubcommandParser(OptionsList global_options
+                                          /* = {} */,
+                                          unsigned flags
+                                          /* = Parser::NONE */)
+    : global(std::move(global_options), flags)
+{
+}
+
+inline void SubcommandParser::add(std::string name, std::string help,
+                                  Factory factory)
+{
+    auto it =
+        std::lower_bound(this->commands.begin(), this->commands.end(), name,
+                         [](const entry &e, const std::string &name)
+                         { return e.name < name; });
+    if (it != this->commands.end() && it->name == name)
+    {
+        throw std::invalid_argument("Duplicate subcommand: " + name);
+    }
+
+    this->commands.insert(it, {std::move(name), std::move(help), factory});
+}
+
+template <class Cmd>
+inline void SubcommandParser::add(std::string name, std::string help)
+{
+    this->add(std::move(name), std::move(help),
+              []() -> std::unique_ptr<Subcommand>
+              { return std::make_unique<Cmd>(); });
+}
+
+inline subcommand_result SubcommandParser::parse(
+    int argc, const char *argv[], int skip_first_n /* = 1 */) const
+{
+    subcommand_result res;
+
+    // the name and arguments after it, matching never sees them
+    std::vector<std::string> command_args;
+    const entry *selected = nullptr;
+    res.unrecognised      = this->global.parse_until(
+        argc, argv, skip_first_n,
+        [&](std::string_view arg)
+        { return (selected = this->find(arg)) != nullptr; },
+        command_args);
+
+    if (selected == nullptr)
+    {
+        return res;
+    }
+
+    res.name    = selected->name;
+    res.command = selected->factory();
+
+    std::vector<const char *> command_argv;
+    command_argv.reserve(command_args.size());
+    for (const std::string &arg : command_args)
+    {
+        command_argv.push_back(arg.c_str());
+    }
+
+    Parser parser(res.command->get_options(), res.command->get_flags());
+    std::vector<std::string> rest = parser.parse(
+        static_cast<int>(command_argv.size()), command_argv.data());
+    res.unrecognised.insert(res.unrecognised.end(),
+                            std::make_move_iterator(rest.begin()),
+                            std::make_move_iterator(rest.end()));
+
+    return res;
+}
+
+inline void SubcommandParser::print_help(std::ostream &os,
+                                         std::string_view cmd,
+                                         size_t min_w /* = 25 */) const
+{
+    std::string out = "Usage: ";
+    out += cmd;
+    if (!this->global.get_options().empty())
+    {
+        out += " <options>";
+    }
+    out += " <command> <command options>\n";
+
+    if (!this->global.get_options().empty())
+    {
+        out += "Options:\n";
+        for (OptionBase *opt : this->global.get_options())
+        {
+            std::pair<std::string, std::string> &&help = opt->get_help();
+            impl::append_help_line(out, help.first, help.second, min_w, 0,
+                                   os.fill());
+        }
+    }
+
+    out += "Commands:\n";
+    for (const entry &command : this->commands)
+    {
+        impl::append_help_line(out, command.name, command.help, min_w, 0,
+                               os.fill());
+    }
+    os << out;
+}
+
+namespace impl
+{
+
+template <class T>
+inline typed_slot<T>::typed_slot(T default_val)
+    : default_val(std::move(default_val))
+{
+}
+
+template <class T>
+inline T &typed_slot<T>::at(unsigned char *values) const
+{
+    return *std::launder(reinterpret_cast<T *>(values + this->offset));
+}
+
+template <class T>
+inline size_t typed_slot<T>::size() const
+{
+    return sizeof(T);
+}
+
+template <class T>
+inline size_t typed_slot<T>::align() const
+{
+    return alignof(T);
+}
+
+template <class T>
+inline void typed_slot<T>::construct(unsigned char *values) const
+{
+    new (values + this->offset) T(this->default_val);
+}
+
+template <class T>
+inline void typed_slot<T>::assign_default(unsigned char *values) const
+{
+    this->at(values) = this->default_val;
+}
+
+template <class T>
+inline void typed_slot<T>::destroy(unsigned char *values) const
+{
+    this->at(values).~T();
+}
+
+[[noreturn]] inline void throw_schema_option()
+{
+    throw std::logic_error("Schema options store values in SchemaResult");
+}
+
+template <class T>
+inline void schema_keyword<T>::from_string(
+    const std::vector<std::string_view> &)
+{
+    throw_schema_option();
+}
+
+template <class T>
+inline schema_keyword<T>::schema_keyword(std::vector<std::string> identifiers,
+                                         std::string help, T default_val)
+    : KeywordOptionBase(std::move(identifiers), std::move(help)),
+      typed_slot<T>(std::move(default_val))
+{
+}
+
+template <class T>
+inline int schema_keyword<T>::get_param_count()
+{
+    return std::is_same_v<T, bool> ? 0 : 1;
+}
+
+template <class T>
+inline bool schema_keyword<T>::matches(std::string_view identifier)
+{
+    return this->has_identifier(identifier);
+}
+
+template <class T>
+inline bool schema_keyword<T>::has_exact_identifiers() const
+{
+    return true;
+}
+
+template <class T>
+inline void schema_keyword<T>::convert(arg_span args,
+                                       unsigned char *values) const
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        this->at(values) = true;
+    }
+    else
+    {
+        impl::convert(args[1], this->at(values));
+    }
+}
+
+template <class T>
+inline void schema_multi_keyword<T>::from_string(
+    const std::vector<std::string_view> &)
+{
+    throw_schema_option();
+}
+
+template <class T>
+inline schema_multi_keyword<T>::schema_multi_keyword(
+    std::vector<std::string> identifiers, std::string help)
+    : KeywordOptionBase(std::move(identifiers), std::move(help)),
+      typed_slot<std::vector<T>>({})
+{
+}
+
+template <class T>
+inline int schema_multi_keyword<T>::get_param_count()
+{
+    return 1;
+}
+
+template <class T>
+inline bool schema_multi_keyword<T>::matches(std::string_view identifier)
+{
+    return this->has_identifier(identifier);
+}
+
+template <class T>
+inline bool schema_multi_keyword<T>::has_exact_identifiers() const
+{
+    return true;
+}
+
+template <class T>
+inline void schema_multi_keyword<T>::convert(arg_span args,
+                                             unsigned char *values) const
+{
+    std::vector<T> &val = this->at(values);
+    T tmp               = impl::make_element<T>(val);
+    impl::convert(args[1], tmp);
+    val.push_back(std::move(tmp));
+}
+
+template <class T>
+inline void schema_positional<T>::from_string(
+    const std::vector<std::string_view> &)
+{
+    throw_schema_option();
+}
+
+template <class T>
+inline schema_positional<T>::schema_positional(std::string name,
+                                               std::string help,
+                                               bool is_required, T default_val)
+    : PositionalOptionBase(std::move(name), std::move(help), is_required),
+      typed_slot<T>(std::move(default_val))
+{
+}
+
+template <class T>
+inline int schema_positional<T>::get_param_count()
+{
+    return 0;
+}
+
+template <class T>
+inline bool schema_positional<T>::matches(std::string_view)
+{
+    return true;
+}
+
+template <class T>
+inline PositionalOptionBase::Arity schema_positional<T>::get_arity() const
+{
+    return SINGLE;
+}
+
+template <class T>
+inline void schema_positional<T>::convert(arg_span args,
+                                          unsigned char *values) const
+{
+    impl::convert(args[0], this->at(values));
+}
+
+template <class T>
+inline void schema_positional_list<T>::from_string(
+    const std::vector<std::string_view> &)
+{
+    throw_schema_option();
+}
+
+template <class T>
+inline schema_positional_list<T>::schema_positional_list(std::string name,
+                                                         std::string help,
+                                                         bool is_required)
+    : PositionalOptionBase(std::move(name), std::move(help), is_required),
+      typed_slot<std::vector<T>>({})
+{
+}
+
+template <class T>
+inline int schema_positional_list<T>::get_param_count()
+{
+    return 0;
+}
+
+template <class T>
+inline bool schema_positional_list<T>::matches(std::string_view)
+{
+    return true;
+}
+
+template <class T>
+inline PositionalOptionBase::Arity schema_positional_list<T>::get_arity() const
+{
+    return LIST;
+}
+
+template <class T>
+inline std::pair<std::string, std::string> schema_positional_list<T>::get_help()
+    const
+{
+    std::string name = this->name + "...";
+    return {(this->is_required) ? std::move(name) : "[" + name + "]",
+            this->help};
+}
+
+template <class T>
+inline void schema_positional_list<T>::convert(arg_span args,
+                                               unsigned char *values) const
+{
+    std::vector<T> &val = this->at(values);
+    for (std::string_view arg : args)
+    {
+        T tmp = impl::make_element<T>(val);
+        impl::convert(arg, tmp);
+        val.push_back(std::move(tmp));
+    }
+}
+
+} // namespace impl
+
+inline Schema::Schema(unsigned flags /* = Parser::NONE */)
+    : flags(flags & ~Parser::PARALLEL_CONVERSION), storage_size(0)
+{
+}
+
+template <class V, class Option>
+inline field<V> Schema::add(std::unique_ptr<Option> option)
+{
+    static_assert(alignof(V) <= alignof(std::max_align_t),
+                  "over-aligned types are not supported");
+
+    if (this->parser != nullptr)
+    {
+        throw std::logic_error("Options added to compiled schema");
+    }
+
+    size_t align   = alignof(V);
+    option->offset = (this->storage_size + align - 1) / align * align;
+    this->storage_size = option->offset + sizeof(V);
+
+    this->slots.push_back(option.get());
+    this->owned.push_back(std::move(option));
+    return {this->slots.size() - 1};
+}
+
+template <class T>
+inline field<T> Schema::keyword(std::vector<std::string> identifiers,
+                                std::string help, T val /* = T() */)
+{
+    return this->add<T>(std::make_unique<impl::schema_keyword<T>>(
+        std::move(identifiers), std::move(help), std::move(val)));
+}
+
+template <class T>
+inline field<std::vector<T>> Schema::multi_keyword(
+    std::vector<std::string> identifiers, std::string help)
+{
+    return this->add<std::vector<T>>(
+        std::make_unique<impl::schema_multi_keyword<T>>(std::move(identifiers),
+                                                        std::move(help)));
+}
+
+template <class T>
+inline field<T> Schema::positional(std::string name, std::string help,
+                                   bool is_required, T val /* = T() */)
+{
+    return this->add<T>(std::make_unique<impl::schema_positional<T>>(
+        std::move(name), std::move(help), is_required, std::move(val)));
+}
+
+template <class T>
+inline field<std::vector<T>> Schema::positional_list(
+    std::string name, std::string help, bool is_required /* = false */)
+{
+    return this->add<std::vector<T>>(
+        std::make_unique<impl::schema_positional_list<T>>(
+            std::move(name), std::move(help), is_required));
+}
+
+inline void Schema::compile()
+{
+    if (this->parser != nullptr)
+    {
+        throw std::logic_error("Schema is already compiled");
+    }
+
+    OptionsList options;
+    options.reserve(this->owned.size());
+    for (const auto &opt : this->owned)
+    {
+        options.push_back(opt.get());
+    }
+    this->parser = std::make_unique<Parser>(std::move(options), this->flags);
+
+    // the environment and ARGP_INSTRUMENT must not make threads parsing
+    // the schema write the same stats, only the PROFILE flag can
+    if (!(this->flags & Parser::PROFILE))
+    {
+        this->parser->collect_stats  = false;
+        this->parser->profile_format = Parser::ProfileFormat::NONE;
+    }
+}
+
+inline void Schema::prepare(SchemaResult &res) const
+{
+    res.unrecognised.clear();
+    res.given.assign(this->slots.size());
+
+    if (res.schema == this)
+    {
+        for (const impl::value_slot *slot : this->slots)
+        {
+            slot->assign_default(res.values());
+        }
+        return;
+    }
+
+    res.destroy();
+    size_t words = (this->storage_size + sizeof(std::max_align_t) - 1) /
+                   sizeof(std::max_align_t);
+    res.storage.resize(words);
+
+    size_t constructed = 0;
+    try
+    {
+        for (; constructed < this->slots.size(); constructed++)
+        {
+            this->slots[constructed]->construct(res.values());
+        }
+    }
+    catch (...)
+    {
+        while (constructed > 0)
+        {
+            this->slots[--constructed]->destroy(res.values());
+        }
+        throw;
+    }
+
+    res.schema = this;
+    res.slots  = &this->slots;
+}
+
+inline void Schema::parse_into(SchemaResult &res, int argc, const char *argv[],
+                               int skip_first_n /* = 1 */) const
+{
+    const Parser &parser = this->get_parser();
+    this->prepare(res);
+
+    impl::value_storage storage = {this->slots.data(), res.values()};
+    std::pmr::vector<impl::mapped_file> files;
+    parser.parse_argv(argc, argv, skip_first_n, files,
+                      std::pmr::get_default_resource(), &res.given,
+                      [&](std::string_view arg)
+                      { res.unrecognised.push_back(std::string(arg)); },
+                      &storage);
+
+    if (parser.has_constraints())
+    {
+        parser.check_constraints(res.given);
+    }
+}
+
+inline SchemaResult Schema::parse(int argc, const char *argv[],
+                                  int skip_first_n /* = 1 */) const
+{
+    SchemaResult res;
+    this->parse_into(res, argc, argv, skip_first_n);
+    return res;
+}
+
+inline Parser &Schema::get_parser()
+{
+    if (this->parser == nullptr)
+    {
+        throw std::logic_error("Schema is not compiled");
+    }
+
+    return *this->parser;
+}
+
+inline const Parser &Schema::get_parser() const
+{
+    if (this->parser == nullptr)
+    {
+        throw std::logic_error("Schema is not compiled");
+    }
+
+    return *this->parser;
+}
+
+inline unsigned char *SchemaResult::values() const
+{
+    return reinterpret_cast<unsigned char *>(
+        const_cast<std::max_align_t *>(this->storage.data()));
+}
+
+inline void SchemaResult::destroy()
+{
+    if (this->slots != nullptr)
+    {
+        for (const impl::value_slot *slot : *this->slots)
+        {
+            slot->destroy(this->values());
+        }
+    }
+    this->schema = nullptr;
+    this->slots  = nullptr;
+}
+
+inline SchemaResult::SchemaResult() : schema(nullptr), slots(nullptr) {}
+
+inline SchemaResult::SchemaResult(SchemaResult &&other) noexcept
+    : schema(other.schema),
+      slots(other.slots),
+      storage(std::move(other.storage)),
+      given(std::move(other.given)),
+      unrecognised(std::move(other.unrecognised))
+{
+    other.schema = nullptr;
+    other.slots  = nullptr;
+}
+
+inline SchemaResult &SchemaResult::operator=(SchemaResult &&other) noexcept
+{
+    if (this != &other)
+    {
+        this->destroy();
+        this->schema       = other.schema;
+        this->slots        = other.slots;
+        this->storage      = std::move(other.storage);
+        this->given        = std::move(other.given);
+        this->unrecognised = std::move(other.unrecognised);
+        other.schema       = nullptr;
+        other.slots        = nullptr;
+    }
+    return *this;
+}
+
+inline SchemaResult::~SchemaResult() { this->destroy(); }
+
+template <class T>
+inline const T &SchemaResult::get(field<T> f) const
+{
+    auto slot = static_cast<const impl::typed_slot<T> *>((*this->slots)[f.id]);
+    return slot->at(this->values());
+}
+
+template <class T>
+inline T &SchemaResult::get(field<T> f)
+{
+    auto slot = static_cast<const impl::typed_slot<T> *>((*this->slots)[f.id]);
+    return slot->at(this->values());
+}
+
+template <class T>
+inline bool SchemaResult::is_set(field<T> f) const
+{
+    return this->given.contains(f.id);
+}
+
+template <class T, size_t N>
+inline constexpr bool StaticKeywordOption<T, N>::matches(
+    std::string_view identifier) const
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        if (this->identifiers[i] == identifier)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+namespace impl
+{
+
+template <size_t N, size_t... I>
+inline constexpr std::array<std::string_view, N> to_array(
+    const std::string_view (&arr)[N], std::index_sequence<I...>)
+{
+    return {{arr[I]...}};
+}
+
+} // namespace impl
+
+template <class T, size_t N>
+inline constexpr StaticKeywordOption<T, N> static_keyword(
+    const std::string_view (&identifiers)[N], std::string_view help,
+    impl::static_default_t<T> val /* = impl::static_default_t<T>() */)
+{
+    return {impl::to_array(identifiers, std::make_index_sequence<N>()), help,
+            val};
+}
+
+template <class T>
+inline constexpr StaticPositionalOption<T> static_positional(
+    std::string_view name, std::string_view help, bool is_required,
+    impl::static_default_t<T> val /* = impl::static_default_t<T>() */)
+{
+    return {name, help, is_required, val};
+}
+
+template <class... Opts>
+template <size_t I>
+inline const std::tuple_element_t<
+    I, typename StaticParser<Opts...>::values_type>
+    &StaticParser<Opts...>::Result::get() const
+{
+    return std::get<I>(this->values);
+}
+
+template <class... Opts>
+template <size_t I>
+inline bool StaticParser<Opts...>::Result::is_set() const
+{
+    return std::get<I>(this->set_flags);
+}
+
+template <class... Opts>
+inline constexpr StaticParser<Opts...>::StaticParser(Opts... opts)
+    : opts(opts...)
+{
+}
+
+template <class... Opts>
+template <size_t I>
+inline bool StaticParser<Opts...>::try_keyword(std::string_view arg, int &i,
+                                               int argc, const char *argv[],
+                                               Result &res) const
+{
+    using opt_type = std::tuple_element_t<I, std::tuple<Opts...>>;
+
+    if constexpr (!opt_type::IS_KEYWORD)
+    {
+        return false;
+    }
+    else
+    {
+        if (!std::get<I>(this->opts).matches(arg))
+        {
+            return false;
+        }
+
+        if constexpr (opt_type::NUM_OPTS == 0)
+        {
+            std::get<I>(res.values) = true;
+        }
+        else
+        {
+            if (i + opt_type::NUM_OPTS >= argc)
+            {
+                throw std::out_of_range("Not enough arguments.");
+            }
+            impl::convert(std::string_view(argv[++i]), std::get<I>(res.values));
+        }
+        std::get<I>(res.set_flags) = true;
+
+        return true;
+    }
+}
+
+template <class... Opts>
+template <size_t I>
+inline bool StaticParser<Opts...>::try_positional(std::string_view arg,
+                                                  Result &res) const
+{
+    using opt_type = std::tuple_element_t<I, std::tuple<Opts...>>;
+
+    if constexpr (opt_type::IS_KEYWORD)
+    {
+        return false;
+    }
+    else
+    {
+        if (std::get<I>(res.set_flags))
+        {
+            return false;
+        }
+
+        impl::convert(arg, std::get<I>(res.values));
+        std::get<I>(res.set_flags) = true;
+
+        return true;
+    }
+}
+
+template <class... Opts>
+template <size_t... I>
+inline void StaticParser<Opts...>::parse_arg(int &i, int argc,
+                                             const char *argv[], Result &res,
+                                             std::index_sequence<I...>) const
+{
+    std::string_view arg = argv[i];
+
+    bool matched = (this->try_keyword<I>(arg, i, argc, argv, res) || ...) ||
+                   (this->try_positional<I>(arg, res) || ...);
+
+    if (!matched)
+    {
+        res.unrecognised.push_back(std::string(arg));
+    }
+}
+
+template <class... Opts>
+template <size_t... I>
+inline typename StaticParser<Opts...>::Result StaticParser<
+    Opts...>::make_result(std::index_sequence<I...>) const
+{
+    return {values_type(typename Opts::value_type(
+                std::get<I>(this->opts).default_val)...),
+            {},
+            {}};
+}
+
+template <class... Opts>
+inline typename StaticParser<Opts...>::Result StaticParser<Opts...>::parse(
+    int argc, const char *argv[], int skip_first_n /* = 1 */) const
+{
+    Result res = this->make_result(std::index_sequence_for<Opts...>());
+
+    for (int i = skip_first_n; i < argc; i++)
+    {
+        this->parse_arg(i, argc, argv, res, std::index_sequence_for<Opts...>());
+    }
+
+    return res;
+}
+
+template <class... Opts>
+inline constexpr const std::tuple<Opts...> &StaticParser<Opts...>::get_options()
+    const
+{
+    return this->opts;
 }
 
 } // namespace argp
@@ -0,0 +1,647 @@
+/**
+ * Benchmark of argp::parse and help rendering.
+ *
+ * Build and run from the repository root:
+ *   g++ -std=c++17 -O2 -I. bench/parse_benchmark.cpp -o parse_benchmark
+ *   ./parse_benchmark [--quick] [--filter <substring>] [--check-scaling]
+ *
+ * Every case reports time and number of heap allocations per parsed argument
+ * (or per printed option for help cases). Allocations are counted by
+ * replacing global operator new in this file. When built with
+ * -DARGP_INSTRUMENT, the same counter is also reported in argp::ParseStats.
+ *
+ * With --check-scaling, worst case inputs (unrecognised arguments, shared
+ * identifier prefixes, long bundles, options consuming all arguments) are
+ * parsed at two sizes instead, and the program fails if the time per argument
+ * grows more than MAX_SCALING_RATIO times, i.e. if parsing is not linear.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "argparser.hpp"
+
+// Replacements must not be inlined, otherwise GCC sees std::free called on
+// a pointer returned by operator new and warns with -Wmismatched-new-delete.
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+namespace
+{
+size_t allocation_count = 0;
+} // namespace
+
+BENCH_NOINLINE void *operator new(size_t size)
+{
+    allocation_count++;
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void *operator new[](size_t size) { return operator new(size); }
+
+BENCH_NOINLINE void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    allocation_count++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+BENCH_NOINLINE void *operator new[](size_t size,
+                                    const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+BENCH_NOINLINE void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+BENCH_NOINLINE void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+BENCH_NOINLINE void operator delete[](void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void *ptr,
+                                      const std::nothrow_t &) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+
+enum class Kind
+{
+    BOOL,
+    INT,
+    STRING
+};
+
+const char *kind_name(Kind kind)
+{
+    switch (kind)
+    {
+    case Kind::BOOL:
+        return "bool";
+    case Kind::INT:
+        return "int";
+    case Kind::STRING:
+        return "string";
+    }
+    return "";
+}
+
+/**
+ * Set of `count` keyword options of the same kind, named `--option-<i>` with
+ * a short alias `-o<i>`, which resembles shape of real command line tools.
+ */
+class OptionSet
+{
+ private:
+    std::vector<std::unique_ptr<argp::OptionBase>> storage;
+
+ public:
+    Kind kind;
+    argp::OptionsList options;
+
+    OptionSet(size_t count, Kind kind) : kind(kind)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            std::vector<std::string> ids = {"--option-" + std::to_string(i),
+                                            "-o" + std::to_string(i)};
+            std::string help = "Help text of option number " +
+                               std::to_string(i) + ", long enough to matter.";
+
+            switch (kind)
+            {
+            case Kind::BOOL:
+                storage.emplace_back(
+                    new argp::KeywordOption<bool>(ids, help));
+                break;
+            case Kind::INT:
+                storage.emplace_back(new argp::KeywordOption<int>(ids, help));
+                break;
+            case Kind::STRING:
+                storage.emplace_back(
+                    new argp::KeywordOption<std::string>(ids, help));
+                break;
+            }
+            options.push_back(storage.back().get());
+        }
+    }
+};
+
+/**
+ * Command line of random options from an OptionSet, with roughly `tokens`
+ * arguments (including parameters), preceded by the program name.
+ */
+class CommandLine
+{
+ private:
+    std::vector<std::string> storage;
+
+ public:
+    std::vector<const char *> argv;
+
+    CommandLine(const OptionSet &set, size_t tokens)
+    {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<size_t> pick(0, set.options.size() - 1);
+
+        storage.reserve(tokens + 2);
+        storage.push_back("benchmark");
+        while (storage.size() - 1 < tokens)
+        {
+            size_t i = pick(gen);
+            storage.push_back((i % 2 ? "-o" : "--option-") + std::to_string(i));
+            if (set.kind == Kind::INT)
+            {
+                storage.push_back(std::to_string(gen() % 1000000));
+            }
+            else if (set.kind == Kind::STRING)
+            {
+                storage.push_back("/some/path/file-" + std::to_string(gen()));
+            }
+        }
+
+        for (const auto &str : storage)
+        {
+            argv.push_back(str.c_str());
+        }
+    }
+
+    int argc() const { return static_cast<int>(argv.size()); }
+};
+
+/**
+ * Arguments built by pushing strings, preceded by the program name.
+ */
+class Arguments
+{
+ private:
+    std::vector<std::string> storage;
+
+ public:
+    std::vector<const char *> argv;
+
+    Arguments() : storage(1, "benchmark") {}
+
+    void push(std::string arg) { storage.push_back(std::move(arg)); }
+
+    /// must be called after the last push
+    void finish()
+    {
+        argv.clear();
+        for (const auto &str : storage)
+        {
+            argv.push_back(str.c_str());
+        }
+    }
+
+    size_t size() const { return storage.size() - 1; }
+
+    int argc() const { return static_cast<int>(argv.size()); }
+};
+
+/**
+ * Keyword option taking all remaining arguments.
+ */
+class RestOption : public argp::KeywordOptionBase
+{
+ protected:
+    virtual void from_string(const std::vector<std::string_view> &) override
+    {
+    }
+    virtual void from_args(argp::arg_span) override {}
+
+ public:
+    RestOption() : KeywordOptionBase({"--rest"}, "Remaining arguments.") {}
+
+    virtual int get_param_count() override { return -1; }
+
+    virtual bool matches(std::string_view identifier) override
+    {
+        return this->has_identifier(identifier);
+    }
+};
+
+struct Measurement
+{
+    double ns_per_item;
+    double allocs_per_item;
+};
+
+/**
+ * Run `fn` repeatedly for at least `min_time` and return average cost per
+ * one of `items` processed by a single run.
+ */
+template <class Fn>
+Measurement measure(size_t items, Fn &&fn,
+                    std::chrono::duration<double> min_time)
+{
+    using clock = std::chrono::steady_clock;
+
+    fn(); // warm up
+
+    size_t runs         = 0;
+    size_t allocs_start = allocation_count;
+    auto start          = clock::now();
+    auto now            = start;
+    do
+    {
+        fn();
+        runs++;
+        now = clock::now();
+    } while (now - start < min_time);
+    size_t allocs = allocation_count - allocs_start;
+
+    double total_items = static_cast<double>(items) * runs;
+    return {std::chrono::duration<double, std::nano>(now - start).count() /
+                total_items,
+            allocs / total_items};
+}
+
+void report(const std::string &name, size_t options, size_t items,
+            const Measurement &m)
+{
+    std::printf("%-28s %8zu %10zu %12.1f %12.3f\n", name.c_str(), options,
+                items, m.ns_per_item, m.allocs_per_item);
+}
+
+const double MAX_SCALING_RATIO = 3.0;
+
+/**
+ * Measure `parse(args)` for arguments built by `build(args, size)` for the
+ * small and the large size, and return false if time per argument grows too
+ * much.
+ */
+template <class Build, class Parse>
+bool check_scaling(const std::string &name, size_t small, size_t large,
+                   Build &&build, Parse &&parse,
+                   std::chrono::duration<double> min_time)
+{
+    double ns[2];
+    size_t sizes[2] = {small, large};
+    for (size_t k = 0; k < 2; k++)
+    {
+        Arguments args;
+        build(args, sizes[k]);
+        args.finish();
+        ns[k] = measure(
+                    args.size(), [&] { parse(args); }, min_time)
+                    .ns_per_item;
+    }
+
+    double ratio = ns[1] / ns[0];
+    bool ok      = ratio <= MAX_SCALING_RATIO;
+    std::printf("%-28s %10zu %10zu %10.1f %10.1f %8.2f %s\n", name.c_str(),
+                small, large, ns[0], ns[1], ratio, ok ? "ok" : "FAIL");
+
+    return ok;
+}
+
+bool check_all_scaling(bool quick, const std::string &filter)
+{
+    auto min_time = std::chrono::duration<double>(quick ? 0.01 : 0.2);
+    size_t small  = 1000;
+    size_t large  = quick ? 20000 : 200000;
+    bool ok       = true;
+
+    auto selected = [&](const std::string &name)
+    { return name.find(filter) != std::string::npos; };
+
+    std::printf("%-28s %10s %10s %10s %10s %8s\n", "case", "small", "large",
+                "ns/small", "ns/large", "ratio");
+
+    OptionSet set(1000, Kind::INT);
+    argp::Parser parser(set.options);
+
+    if (selected("scaling/unrecognised"))
+    {
+        ok &= check_scaling(
+            "scaling/unrecognised", small, large,
+            [](Arguments &args, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    args.push("--unknown-" + std::to_string(i));
+                }
+            },
+            [&](Arguments &args)
+            { parser.parse(args.argc(), args.argv.data()); },
+            min_time);
+    }
+
+    if (selected("scaling/many_options"))
+    {
+        // the same arguments with 10 and 10000 options, time must not grow
+        Arguments args;
+        for (size_t i = 0; i < 10000; i++)
+        {
+            args.push("-o" + std::to_string(i % 10));
+            args.push(std::to_string(i));
+        }
+        args.finish();
+
+        double ns[2];
+        size_t counts[2] = {10, 10000};
+        for (size_t k = 0; k < 2; k++)
+        {
+            OptionSet options(counts[k], Kind::INT);
+            argp::Parser option_parser(options.options);
+            ns[k] = measure(
+                        args.size(),
+                        [&]
+                        { option_parser.parse(args.argc(), args.argv.data()); },
+                        min_time)
+                        .ns_per_item;
+        }
+
+        double ratio = ns[1] / ns[0];
+        bool case_ok = ratio <= MAX_SCALING_RATIO;
+        std::printf("%-28s %10zu %10zu %10.1f %10.1f %8.2f %s\n",
+                    "scaling/many_options", counts[0], counts[1], ns[0], ns[1],
+                    ratio, case_ok ? "ok" : "FAIL");
+        ok &= case_ok;
+    }
+
+    if (selected("scaling/shared_prefix"))
+    {
+        std::vector<std::unique_ptr<argp::KeywordOption<int>>> storage;
+        argp::OptionsList options;
+        for (size_t i = 0; i < 1000; i++)
+        {
+            storage.emplace_back(new argp::KeywordOption<int>(
+                {"--prefix-shared-by-all-" + std::to_string(i)}, "Help."));
+            options.push_back(storage.back().get());
+        }
+        argp::Parser prefix_parser(options, argp::Parser::ABBREVIATIONS |
+                                                argp::Parser::INLINE_VALUES);
+
+        ok &= check_scaling(
+            "scaling/shared_prefix", small, large,
+            [](Arguments &args, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    std::string id = "--prefix-shared-by-all-" +
+                                     std::to_string(i % 1000);
+                    args.push(i % 2 ? id + "=" + std::to_string(i) : id + "x");
+                }
+            },
+            [&](Arguments &args)
+            { prefix_parser.parse(args.argc(), args.argv.data()); },
+            min_time);
+    }
+
+    if (selected("scaling/bundles"))
+    {
+        std::vector<std::unique_ptr<argp::KeywordOption<bool>>> storage;
+        argp::OptionsList options;
+        for (char c = 'a'; c <= 'z'; c++)
+        {
+            storage.emplace_back(new argp::KeywordOption<bool>(
+                {std::string("-") + c}, "Help."));
+            options.push_back(storage.back().get());
+        }
+        argp::Parser bundle_parser(options, argp::Parser::BUNDLED_FLAGS);
+
+        ok &= check_scaling(
+            "scaling/bundles", small, large,
+            [](Arguments &args, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    args.push("-abcdefghijklmnopqrstuvwxyz");
+                }
+            },
+            [&](Arguments &args)
+            { bundle_parser.parse(args.argc(), args.argv.data()); },
+            min_time);
+    }
+
+    if (selected("scaling/rest"))
+    {
+        RestOption rest;
+        argp::Parser rest_parser({&rest});
+
+        ok &= check_scaling(
+            "scaling/rest", small, large,
+            [](Arguments &args, size_t n)
+            {
+                args.push("--rest");
+                for (size_t i = 1; i < n; i++)
+                {
+                    args.push("--option-" + std::to_string(i));
+                }
+            },
+            [&](Arguments &args)
+            { rest_parser.parse(args.argc(), args.argv.data()); },
+            min_time);
+    }
+
+    if (selected("scaling/positional_list"))
+    {
+        argp::KeywordOption<bool> flag({"-f"}, "Help.");
+        argp::PositionalListOption<std::string> files("files", "Help.", false);
+        argp::Parser list_parser({&flag, &files});
+
+        ok &= check_scaling(
+            "scaling/positional_list", small, large,
+            [](Arguments &args, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    args.push(i % 100 ? "file-" + std::to_string(i) : "-f");
+                }
+            },
+            [&](Arguments &args)
+            {
+                argp::PositionalListOption<std::string> fresh("files", "Help.",
+                                                              false);
+                std::swap(files, fresh);
+                list_parser.parse(args.argc(), args.argv.data());
+            },
+            min_time);
+    }
+
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[])
+{
+#ifdef ARGP_INSTRUMENT
+    argp::instrument::allocation_counter = [] { return allocation_count; };
+#endif
+
+    argp::KeywordOption<bool> quick({"-q", "--quick"},
+                                    "Run only small inputs, for smoke tests.");
+    argp::KeywordOption<std::string> filter(
+        {"-f", "--filter"}, "Run only cases whose name contains this string.");
+    argp::KeywordOption<bool> scaling(
+        {"--check-scaling"}, "Check that parsing worst case inputs is linear.");
+    argp::KeywordOption<bool> help({"-h", "--help"}, "Show this help.");
+    argp::OptionsList opts = {&quick, &filter, &scaling, &help};
+
+    auto unrecognised = argp::parse(argc, argv, opts);
+    if (help.value() || !unrecognised.empty())
+    {
+        argp::print_help(std::cout, argv[0], opts);
+        return unrecognised.empty() ? 0 : 1;
+    }
+
+    if (scaling.value())
+    {
+        return check_all_scaling(quick.value(), filter.value()) ? 0 : 1;
+    }
+
+    auto min_time = std::chrono::duration<double>(quick.value() ? 0.01 : 0.2);
+    std::vector<size_t> option_counts = {10, 100, 1000};
+    std::vector<size_t> token_counts  = {10, 1000, 100000, 1000000};
+    if (quick.value())
+    {
+        token_counts = {10, 1000};
+    }
+
+    auto selected = [&](const std::string &name)
+    { return name.find(filter.value()) != std::string::npos; };
+
+    std::printf("%-28s %8s %10s %12s %12s\n", "case", "options", "items",
+                "ns/item", "allocs/item");
+
+    for (Kind kind : {Kind::BOOL, Kind::INT, Kind::STRING})
+    {
+        for (size_t option_count : option_counts)
+        {
+            OptionSet set(option_count, kind);
+
+            for (size_t tokens : token_counts)
+            {
+                CommandLine cmd(set, tokens);
+                size_t args = cmd.argv.size() - 1;
+
+                std::string name = std::string("parse/") + kind_name(kind);
+                if (selected(name))
+                {
+                    auto m = measure(
+                        args,
+                        [&] {
+                            argp::parse(cmd.argc(), cmd.argv.data(),
+                                        set.options);
+                        },
+                        min_time);
+                    report(name, option_count, args, m);
+                }
+
+                name = std::string("parser_reuse/") + kind_name(kind);
+                if (selected(name))
+                {
+                    argp::Parser parser(set.options);
+                    auto m = measure(
+                        args,
+                        [&] { parser.parse(cmd.argc(), cmd.argv.data()); },
+                        min_time);
+                    report(name, option_count, args, m);
+                }
+            }
+        }
+    }
+
+    if (selected("response_file"))
+    {
+        // mostly plain characters, with some quoted arguments
+        OptionSet set(100, Kind::STRING);
+        argp::Parser parser(set.options, argp::Parser::RESPONSE_FILES);
+        std::string path =
+            (std::filesystem::temp_directory_path() / "parse_benchmark.rsp")
+                .string();
+
+        for (size_t tokens : token_counts)
+        {
+            CommandLine cmd(set, tokens);
+            {
+                std::ofstream file(path);
+                for (int i = 1; i < cmd.argc(); i++)
+                {
+                    file << ((i % 16 == 0) ? "\"" : "") << cmd.argv[i]
+                         << ((i % 16 == 0) ? "\"\n" : "\n");
+                }
+            }
+
+            std::string at_path = "@" + path;
+            const char *argv[]  = {"benchmark", at_path.c_str()};
+            size_t args         = cmd.argv.size() - 1;
+            auto m              = measure(
+                args, [&] { parser.parse(2, argv); }, min_time);
+            report("response_file", set.options.size(), args, m);
+        }
+
+        std::filesystem::remove(path);
+    }
+
+    for (size_t option_count : option_counts)
+    {
+        std::string name = "print_help";
+        if (!selected(name))
+        {
+            continue;
+        }
+
+        OptionSet set(option_count, Kind::STRING);
+        auto m = measure(
+            option_count,
+            [&]
+            {
+                std::ostringstream oss;
+                argp::print_help(oss, "benchmark", set.options);
+            },
+            min_time);
+        report(name, option_count, option_count, m);
+    }
+
+    for (size_t option_count : option_counts)
+    {
+        std::string name = "parser_help";
+        if (!selected(name))
+        {
+            continue;
+        }
+
+        OptionSet set(option_count, Kind::STRING);
+        argp::Parser parser(set.options);
+        auto m = measure(
+            option_count, [&] { parser.help("benchmark", 25, 80); }, min_time);
+        report(name, option_count, option_count, m);
+    }
+
+    return 0;
+}
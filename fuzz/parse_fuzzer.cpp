@@ -0,0 +1,302 @@
+/**
+ * libFuzzer target for argp::Parser.
+ *
+ * Build and run from the repository root:
+ *   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -I. \
+ *       fuzz/parse_fuzzer.cpp -o parse_fuzzer
+ *   ./parse_fuzzer -max_len=4096
+ *
+ * The first byte of the input selects Parser::Flags, the second one the entry
+ * point (Parser::parse, parse_stream, parse_layered, Schema or
+ * SubcommandParser), the rest is split at null bytes into arguments. With
+ * RESPONSE_FILES, the rest is also written to a temporary file passed as
+ * the first argument `@file`, and parse_layered reads it as the config file.
+ * Options cover every option class, identifiers with shared prefixes and an
+ * option consuming all remaining arguments. Exceptions thrown for invalid
+ * input are expected, anything else (crash, sanitizer report, timeout) is
+ * a bug.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "argparser.hpp"
+
+namespace
+{
+
+/**
+ * Keyword option taking all remaining arguments.
+ */
+class RestOption : public argp::KeywordOptionBase
+{
+ protected:
+    virtual void from_string(
+        const std::vector<std::string_view> &strings) override
+    {
+        this->from_args(argp::arg_span(strings));
+    }
+
+    virtual void from_args(argp::arg_span args) override
+    {
+        this->count += args.size() - 1;
+    }
+
+ public:
+    size_t count = 0;
+
+    RestOption() : KeywordOptionBase({"--", "--rest"}, "Remaining arguments.")
+    {
+    }
+
+    virtual int get_param_count() override { return -1; }
+
+    virtual bool matches(std::string_view identifier) override
+    {
+        return this->has_identifier(identifier);
+    }
+};
+
+/**
+ * Keyword option with custom matching, so it is not in the identifier index.
+ */
+class PatternOption : public argp::KeywordOptionBase
+{
+ protected:
+    virtual void from_string(const std::vector<std::string_view> &) override
+    {
+    }
+
+ public:
+    PatternOption() : KeywordOptionBase({"-D<name>"}, "Define a name.") {}
+
+    virtual int get_param_count() override { return 0; }
+
+    virtual bool matches(std::string_view identifier) override
+    {
+        return identifier.size() > 2 && identifier.substr(0, 2) == "-D";
+    }
+};
+
+/**
+ * Subcommands selected by SubcommandParser, with a keyword and a positional
+ * option each.
+ */
+class BuildCommand : public argp::Subcommand
+{
+ public:
+    argp::KeywordOption<int> jobs{{"-j", "--jobs"}, "Jobs."};
+    argp::PositionalListOption<std::string> targets{"targets", "Targets.",
+                                                    false};
+
+    virtual argp::OptionsList get_options() override
+    {
+        return {&this->jobs, &this->targets};
+    }
+};
+
+class RunCommand : public argp::Subcommand
+{
+ public:
+    argp::LazyKeywordOption<double> timeout{{"-t", "--timeout"}, "Timeout."};
+    argp::PositionalOption<std::string> program{"program", "Program.", true};
+
+    virtual argp::OptionsList get_options() override
+    {
+        return {&this->timeout, &this->program};
+    }
+
+    virtual unsigned get_flags() const override
+    {
+        return argp::Parser::INLINE_VALUES | argp::Parser::BUNDLED_FLAGS;
+    }
+};
+
+enum class EntryPoint
+{
+    PARSE,
+    STREAM,
+    LAYERED,
+    SCHEMA,
+    SUBCOMMAND,
+    COUNT
+};
+
+/**
+ * Temporary file of this process, removed at exit. The name is random, so
+ * parallel fuzzing jobs don't share it.
+ */
+struct TempFile
+{
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("argp_fuzz_" +
+                         std::to_string(std::random_device()()) + ".rsp"))
+                           .string();
+
+    ~TempFile()
+    {
+        std::error_code ec;
+        std::filesystem::remove(this->path, ec);
+    }
+};
+
+/**
+ * Write `data` to the temporary file and return its path. Every input
+ * overwrites it.
+ */
+std::string write_temp_file(std::string_view data)
+{
+    static const TempFile file;
+
+    std::ofstream(file.path, std::ios_base::binary)
+        .write(data.data(), static_cast<std::streamsize>(data.size()));
+    return file.path;
+}
+
+void parse_schema(unsigned flags, std::vector<const char *> &argv)
+{
+    argp::Schema schema(flags);
+    auto number  = schema.keyword<int>({"-n", "--number"}, "Number.", 1);
+    auto verbose = schema.keyword<bool>({"-v", "--verbose"}, "Verbose.");
+    auto include =
+        schema.multi_keyword<std::string>({"-I", "--include"}, "Repeated.");
+    auto first  = schema.positional<std::string>("first", "First.", true);
+    auto others = schema.positional_list<int>("others", "Others.");
+    schema.compile();
+
+    argp::SchemaResult res = schema.parse(static_cast<int>(argv.size()),
+                                          argv.data());
+    (void)res.get(number);
+    (void)res.get(verbose);
+    (void)res.get(include);
+    (void)res.get(first);
+    (void)res.get(others);
+}
+
+void parse_subcommand(unsigned flags, std::vector<const char *> &argv)
+{
+    argp::KeywordOption<bool> verbose({"-v", "--verbose"}, "Verbose.");
+    argp::KeywordOption<std::string> config({"-C", "--config"}, "Config.");
+    argp::SubcommandParser parser({&verbose, &config}, flags);
+    parser.add<BuildCommand>("build", "Build targets.");
+    parser.add<RunCommand>("run", "Run a program.");
+
+    parser.parse(static_cast<int>(argv.size()), argv.data());
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size < 2)
+    {
+        return 0;
+    }
+
+    // all flags except PROFILE, which only writes reports to stderr
+    unsigned flags = data[0] & (argp::Parser::RESPONSE_FILES |
+                                argp::Parser::ABBREVIATIONS |
+                                argp::Parser::INLINE_VALUES |
+                                argp::Parser::BUNDLED_FLAGS |
+                                argp::Parser::PARALLEL_CONVERSION |
+                                argp::Parser::REQUIRED_POSITIONALS);
+    auto entry = static_cast<EntryPoint>(
+        data[1] % static_cast<uint8_t>(EntryPoint::COUNT));
+
+    std::string_view input(reinterpret_cast<const char *>(data + 2), size - 2);
+    std::vector<std::string> storage(1, "fuzz");
+    std::string file;
+    if ((flags & argp::Parser::RESPONSE_FILES) ||
+        entry == EntryPoint::LAYERED)
+    {
+        file = write_temp_file(input);
+    }
+    if (flags & argp::Parser::RESPONSE_FILES)
+    {
+        storage.push_back("@" + file);
+    }
+
+    size_t pos = 0;
+    while (pos <= input.size())
+    {
+        size_t end = std::min(input.find('\0', pos), input.size());
+        storage.emplace_back(input.substr(pos, end - pos));
+        pos = end + 1;
+    }
+
+    std::vector<const char *> argv;
+    for (const auto &arg : storage)
+    {
+        argv.push_back(arg.c_str());
+    }
+
+    size_t callbacks = 0;
+    argp::KeywordOption<bool> verbose({"-v", "--verbose"}, "Verbose.");
+    argp::KeywordOption<bool> all({"-a", "--all"}, "All.");
+    argp::KeywordOption<int> number({"-n", "--number"}, "Number.");
+    argp::KeywordOption<double> ratio({"-r", "--ratio"}, "Ratio.");
+    argp::KeywordOption<std::string> opt({"-o", "--opt"}, "Shared prefix.");
+    argp::KeywordOption<std::string> option({"--option"}, "Shared prefix.");
+    argp::KeywordOption<std::string> optional({"--optional"}, "Shared prefix.");
+    argp::MultiKeywordOption<int> include({"-I", "--include"}, "Repeated.");
+    argp::LazyKeywordOption<long> lazy({"-l", "--lazy"}, "Lazy.");
+    auto callback = argp::callback_option<std::string>(
+        {"-c", "--callback"}, "Callback.",
+        [&](std::string &value) { callbacks += value.size(); });
+    RestOption rest;
+    PatternOption pattern;
+    argp::PositionalOption<std::string> first("first", "First.", false);
+    argp::PositionalListOption<std::string> others("others", "Others.", false);
+
+    argp::Parser parser({&verbose, &all, &number, &ratio, &opt, &option,
+                         &optional, &include, &lazy, &callback, &rest,
+                         &pattern, &first, &others},
+                        flags);
+    parser.set_threads(2);
+
+    try
+    {
+        std::istringstream stream{std::string(input)};
+        switch (entry)
+        {
+        case EntryPoint::PARSE:
+            parser.parse(static_cast<int>(argv.size()), argv.data());
+            break;
+        case EntryPoint::STREAM:
+            parser.parse_stream(argp::stream_tokens(stream));
+            break;
+        case EntryPoint::LAYERED:
+            parser.parse_layered(static_cast<int>(argv.size()), argv.data(),
+                                 {"ARGP_FUZZ_", file});
+            break;
+        case EntryPoint::SCHEMA:
+            parse_schema(flags, argv);
+            break;
+        case EntryPoint::SUBCOMMAND:
+            parse_subcommand(flags, argv);
+            break;
+        case EntryPoint::COUNT:
+            break;
+        }
+        parser.validate_all();
+    }
+    catch (const std::invalid_argument &)
+    {
+    }
+    catch (const std::out_of_range &)
+    {
+    }
+
+    parser.help("fuzz", 25, 40);
+
+    return 0;
+}